@@ -0,0 +1,22 @@
+/*
+ * Author: Agha Muhammad Aslam
+ * Description: Interface for loadable built-ins of the mini shell.
+ *
+ * A shared library is loaded with `enable -f lib.so NAME`. For every built-in NAME the library exports
+ * a function NAME_builtin with the signature below. It runs inside the shell process, so there is no fork() and no exec.
+ *
+ *   argc, argv: the arguments like in main(), argv[0] is NAME and argv[argc] is NULL
+ *   fds:        fds[0], fds[1], fds[2] are stdin, stdout and stderr of the built-in (redirections are already applied)
+ *   return:     the exit status, it is stored as return value of the last command (see `ret`)
+ *
+ * Build a built-in with: gcc -shared -fPIC hello.c -o hello.so
+ */
+
+#ifndef MINISHELL_BUILTIN_H
+#define MINISHELL_BUILTIN_H
+
+typedef int minishell_builtin_fn(int argc, char **argv, int fds[3]);
+
+#define MINISHELL_BUILTIN_SUFFIX "_builtin" // > NAME + this suffix is the symbol that is looked up with dlsym()
+
+#endif
@@ -0,0 +1,37 @@
+#if 0
+set -x "$(dirname $0)/$(basename $0 .c)"
+exec ${CC:-cc} ${CFLAGS:--Wall -Wextra -g} $0 -o $1
+#endif
+
+/* Start the shell under test again, the one that runs this helper.
+ * With a FILE argument its stdin is that file, otherwise it is inherited
+ * (e.g. a pipe).  Used to feed a script to the shell non-interactively. */
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <unistd.h>
+
+int main(int argc, char **argv)
+{
+    char link[64], shell[PATH_MAX];
+    snprintf(link, sizeof(link), "/proc/%d/exe", (int)getppid());
+    ssize_t n = readlink(link, shell, sizeof(shell) - 1);
+    if (n < 0) {
+        perror(link);
+        return 1;
+    }
+    shell[n] = '\0';
+
+    if (argc > 1) {
+        int fd = open(argv[1], O_RDONLY);
+        if (fd < 0 || dup2(fd, STDIN_FILENO) < 0) {
+            perror(argv[1]);
+            return 1;
+        }
+        close(fd);
+    }
+    execl(shell, shell, (char *)NULL);
+    perror(shell);
+    return 1;
+}
@@ -0,0 +1,27 @@
+#if 0
+set -x "$(dirname $0)/$(basename $0 .c)"
+exec ${CC:-cc} ${CFLAGS:--Wall -Wextra -g} -shared -fPIC $0 -o $1
+#endif
+
+/* Loadable built-in for the test of `enable -f`: prints its arguments
+ * in upper case, like `echo` | `tr a-z A-Z` but without fork and exec. */
+
+#include <ctype.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../minishell_builtin.h"
+
+
+int upper_builtin(int argc, char **argv, int fds[3])
+{
+    for (int i = 1; i < argc; i++) {
+        char word[256];
+        size_t n = strlen(argv[i]);
+        if (n >= sizeof(word)) n = sizeof(word) - 1;
+        for (size_t k = 0; k < n; k++) word[k] = toupper((unsigned char)argv[i][k]);
+        word[n++] = (i == argc - 1) ? '\n' : ' ';
+        if (write(fds[1], word, n) != (ssize_t)n) return 1;
+    }
+    return 0;
+}
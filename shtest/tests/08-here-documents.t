@@ -0,0 +1,10 @@
+# Inline input with here-documents (<<) and here-strings (<<<)
+#
+→ cat <<EOF⏎
+→ hello heredoc⏎
+→ EOF⏎
+↵ hello heredoc
+→ wc -c <<< "foo bar baz"⏎
+↵ 12
+→ tr a-z n-za-m <<<abc | wc -c⏎
+↵ 4
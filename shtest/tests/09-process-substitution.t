@@ -0,0 +1,14 @@
+# Process substitution <(cmd) and >(cmd), the command gets a /dev/fd/N path
+#
+→ cat <(echo foo bar baz) | wc -c⏎
+↵ 12
+→ diff <(echo a) <(echo b) | wc -l⏎
+↵ 4
+→ wc -l <(date +%s | tr 0-9 a-j; echo x)⏎
+↵ 2 /dev/fd/
+→ tee >(tr a-z A-Z) <<< zebra⏎
+↵ ZEBRA
+→ cat <(tr a-z A-Z <<< hi)⏎
+↵ HI
+→ cat <(true | cat | cat | cat | cat) | wc -c⏎
+↵ 0
@@ -0,0 +1,19 @@
+# Built-in timeout for a whole pipeline
+#
+→ timeout 0.2 sleep 3⏎
+⌛
+→ ret⏎
+↵ 124
+→ timeout 2 tr a-z n-za-m⏎
+→ foo bar baz⏎
+↵ sbb one onm
+→ ^D
+→ ret⏎
+↵ 0
+→ timeout 0.3 cat | wc -c⏎
+⌛
+⌛
+→ ret⏎
+↵ 124
+→ timeout 0.5 cat <(sleep 4); ret⏎
+↵ 124
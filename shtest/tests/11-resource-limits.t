@@ -0,0 +1,19 @@
+# Resource limits with ulimit (for the shell) and limit (for one command)
+#
+→ ulimit -n 123⏎
+→ ulimit -n⏎
+↵ 123
+→ limit -n 77 -- cat /proc/self/limits | grep -c files.*77.*77⏎
+↵ 1
+→ ulimit -n⏎
+↵ 123
+→ limit - ls⏎
+↵ limit: unknown option '-'
+→ ulimit 1000⏎
+→ ulimit -f⏎
+↵ 1000
+→ seq 3 | wc -l⏎
+↵ 3
+→ ulimit unlimited⏎
+→ ulimit -f⏎
+↵ unlimited
@@ -0,0 +1,24 @@
+# Coprocess with bidirectional pipes, used by several later commands
+#
+→ coproc UP sed -u s/^/reply:/⏎
+→ echo hello >&UP⏎
+→ head -n 1 <&UP⏎
+↵ reply:hello
+→ echo world >&UP; head -n 1 <&UP⏎
+↵ reply:world
+→ jobs⏎
+↵ [UP]
+→ coproc SHOUT tr a-z A-Z <<< hey⏎
+→ head -n 1 <&SHOUT⏎
+↵ HEY
+→ coproc LINES wc -l <<EOF⏎
+→ first body line⏎
+→ second body line⏎
+→ EOF⏎
+→ head -n 1 <&LINES⏎
+↵ 2
+→ coproc UP cat <<EOF⏎
+→ not run by the shell⏎
+→ EOF⏎
+↵ coproc: 'UP' is still running
+≠ execvp failed
@@ -0,0 +1,13 @@
+# Loadable built-ins with enable -f, dispatched like the native built-ins
+#
+→ enable -f helpers/upper_builtin upper⏎
+→ upper foo bar baz⏎
+↵ FOO BAR BAZ
+→ upper abc | wc -c⏎
+↵ 4
+→ upper xyz >&2⏎
+↵ XYZ
+→ enable⏎
+↵ upper (loaded)
+→ enable -d upper; upper abc⏎
+≠ ABC
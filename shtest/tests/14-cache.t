@@ -0,0 +1,56 @@
+# cache: the output of a command is stored, a second run with the same inputs only replays it
+#
+→ export MINISHELL_CACHE_DIR=cache-store⏎
+→ touch cache-input⏎
+→ cache --inputs cache-input -- mkdir cache-dir⏎
+→ rmdir cache-dir⏎
+→ cache --inputs cache-input -- mkdir cache-dir⏎
+→ ls cache-dir⏎
+↵ ls: cannot access 'cache-dir': No such file or directory
+→ cache --inputs cache-input -- wc -c cache-input⏎
+↵ 0 cache-input
+→ cache --inputs cache-input -- wc -c cache-input⏎
+↵ 0 cache-input
+→ cache --inputs cache-input -- ls cache-missing⏎
+↵ ls: cannot access 'cache-missing': No such file or directory
+→ cache --inputs cache-input -- ls cache-missing; ret⏎
+↵ ls: cannot access 'cache-missing': No such file or directory
+↵ 2
+→ touch cache-input⏎
+→ cache --inputs cache-input -- mkdir cache-dir⏎
+→ rmdir cache-dir; ret⏎
+↵ 0
+→ rm cache-input⏎
+# a here-document is read also on a hit, its body is part of the key
+→ cache wc -l <<EOF⏎
+→ one⏎
+→ EOF⏎
+↵ 1
+→ cache wc -l <<EOF⏎
+→ one⏎
+→ mkdir cache-injected⏎
+→ EOF⏎
+↵ 2
+→ cache wc -l <<EOF⏎
+→ one⏎
+→ EOF⏎
+↵ 1
+→ cache wc -l <<EOF⏎
+→ one⏎
+→ mkdir cache-injected⏎
+→ EOF⏎
+↵ 2
+→ ls cache-injected⏎
+↵ ls: cannot access 'cache-injected': No such file or directory
+# a process that the command leaves in the background keeps stdout open, the prompt must not wait for it
+→ tee cache-background <<EOF | wc -l⏎
+→ sleep 4 &⏎
+→ echo started⏎
+→ EOF⏎
+↵ 2
+→ cache -- sh cache-background; echo prompt is back⏎
+↵ started
+↵ prompt is back
+→ rm -r cache-store cache-background⏎
+→ ls cache-store⏎
+↵ ls: cannot access 'cache-store': No such file or directory
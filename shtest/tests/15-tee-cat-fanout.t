@@ -0,0 +1,22 @@
+# Built-ins cat and tee (splice/tee) and the fan-out producer |+ consumer |+ consumer
+#
+→ seq 1 1000 | tee tee-out | wc -l⏎
+↵ 1000
+→ cat tee-out tee-out | wc -l⏎
+↵ 2000
+→ seq 3 | tee -a tee-out | tail -n 1⏎
+↵ 3
+→ cat tee-out | tail -n 1⏎
+↵ 3
+→ cat tee-missing; ret⏎
+↵ cat: tee-missing: No such file or directory
+↵ 1
+→ seq 1 100 |+ wc -l⏎
+↵ 100
+→ seq 1 100 |+ grep 7 | sort -o fan-out |+ tail -n 1⏎
+↵ 100
+→ wc -l fan-out⏎
+↵ 19 fan-out
+→ seq 1 100 |+ wc -l |+ tail -n 1 | tr 0 x⏎
+↵ 1xx
+→ rm tee-out fan-out⏎
@@ -0,0 +1,48 @@
+# export, history and hash: the state that is saved in the session snapshot (MINISHELL_SESSION)
+#
+→ export GREETING=hallo⏎
+→ printenv GREETING⏎
+↵ hallo
+→ export⏎
+↵ GREETING=hallo
+→ history | grep -c GREETING⏎
+↵ 3
+→ seq 3 | wc -l⏎
+↵ 3
+→ hash | grep -c /wc⏎
+↵ 1
+→ hash -r; hash | wc -l⏎
+↵ 0
+# a shell that is started again loads the snapshot, a relative MINISHELL_SESSION stays where the shell started
+→ mkdir session-dir session-bin⏎
+→ export MINISHELL_SESSION=session-file⏎
+→ pwd | xargs printf export\x20PATH=%s/session-bin:/usr/bin:/bin\x0a | tee session-save | grep -c session-bin⏎
+↵ 1
+→ tee -a session-save <<EOF | wc -l⏎
+→ cd session-dir⏎
+→ export SESSION_COLOR=green⏎
+→ seq 2 | wc -l⏎
+→ EOF⏎
+↵ 3
+→ tee session-load <<EOF | wc -l⏎
+→ pwd⏎
+→ printenv SESSION_COLOR⏎
+→ hash | grep -c /wc⏎
+→ history | grep -c SESSION_COLOR=green⏎
+→ EOF⏎
+↵ 4
+→ helpers/rerun_shell session-save⏎
+← > 2
+→ helpers/rerun_shell session-load⏎
+← /session-dir
+← > green
+← > 1
+← > 2
+# a program added to a PATH directory changes its mtime, the command paths of the snapshot are not used
+→ touch session-bin/new-program⏎
+→ helpers/rerun_shell session-load⏎
+← /session-dir
+← > green
+← > 0
+← > 3
+→ rm -r session-dir session-bin session-save session-load session-file⏎
@@ -0,0 +1,46 @@
+# capture on: the output of the last commands is kept, last [N] prints it again without running the command
+#
+→ last⏎
+↵ last: capture is off, turn it on with `capture on`
+→ capture on⏎
+→ seq 1 5 | tr 1-5 a-e⏎
+↵ e
+→ ls capture-missing⏎
+↵ ls: cannot access 'capture-missing': No such file or directory
+→ last⏎
+↵ ls: cannot access 'capture-missing': No such file or directory
+↵ [last 1] ls capture-missing: exit 2,
+→ last 2 | grep c⏎
+↵ c
+→ last | grep -c capture-missing⏎
+↵ 1
+→ last 9⏎
+↵ last: only 2 command(s) captured
+→ tee capture-background <<EOF | wc -l⏎
+→ sleep 4 &⏎
+→ echo started⏎
+→ EOF⏎
+↵ 2
+→ sh capture-background; echo prompt is back⏎
+↵ started
+↵ prompt is back
+→ last 2⏎
+↵ started
+→ rm capture-background⏎
+# a cache hit is recorded like a run
+→ export MINISHELL_CACHE_DIR=capture-cache⏎
+→ cache -- echo cached⏎
+↵ cached
+→ echo other; cache -- echo cached⏎
+↵ other
+↵ cached
+→ last⏎
+↵ cached
+↵ [last 1] echo cached: exit 0,
+→ last 2⏎
+↵ other
+↵ [last 2] echo other: exit 0,
+→ rm -r capture-cache⏎
+→ capture off⏎
+→ last⏎
+↵ last: capture is off, turn it on with `capture on`
@@ -0,0 +1,17 @@
+# A script on stdin: a child that reads stdin gets the lines after its command, then the shell resumes
+#
+→ tee input-script <<EOF | wc -l⏎
+→ head -n 1⏎
+→ consumed by head⏎
+→ echo resumed after head⏎
+→ tr a-z A-Z⏎
+→ first rest line⏎
+→ second rest line⏎
+→ EOF⏎
+↵ 6
+→ helpers/rerun_shell input-script⏎
+← > consumed by head
+← > resumed after head
+← > FIRST REST LINE
+↵ SECOND REST LINE
+→ rm input-script⏎
@@ -2,11 +2,19 @@
  * Author: Agha Muhammad Aslam
  * Description: This mini shell implements basic functions like command execution, directory changing,
  * pipelines (|), multiple commands in one input (;), displaying the last return value (ret), and capturing signals like Ctrl+C.
+ * Inline input can be given to a command with here-documents (<<EOF) and here-strings (<<<).
+ * With process substitution (<(cmd) and >(cmd)) the output or input of another command is given as /dev/fd/N path.
+ * A whole pipeline can be limited in time with the built-in `timeout [-k KILLAFTER] DURATION cmd...`.
+ * Resource limits are set with `ulimit` for the shell itself, or with the prefix `limit -v KB ... cmd` for one command.
+ * `coproc NAME cmd` starts a long-lived worker, later commands talk to it with the redirections >&NAME and <&NAME.
+ * Built-ins are dispatched through a table, more built-ins can be loaded from shared libraries with `enable -f lib.so NAME`.
  * 
  * References:
  * execv vs execvp https://youtu.be/OVFEWSP7n8c?si=SyYfzKq_GNjYOmw-$0 
  */ 
 
+#define _GNU_SOURCE     // > needed for memfd_create() on Linux
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -15,6 +23,25 @@
 #include <sys/wait.h>
 #include <signal.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <time.h>
+#include <termios.h>
+#include <sys/resource.h>
+#include <dlfcn.h>
+#include <stdint.h>
+#ifdef __linux__
+#include <sys/sendfile.h> // > splice(), tee() and sendfile() for the zero-copy cat and tee, there is no such API on macOS
+#endif
+
+#include "minishell_builtin.h"
+
+#ifdef __APPLE__
+#define st_mtim st_mtimespec // > macOS calls the mtime with nanoseconds of struct stat st_mtimespec
+#endif
 
 #define MAX_ARGS 100 
 #define MAX_LINE 1024
@@ -22,11 +49,159 @@
                         // > Linux may have 4096 bytes, but 1024 is a common limit for many systems.
                         // > If you want to change this, you can change it to 4096,
 
+#define HEREDOC_PIPE_MAX 4096 // > here-document bodies up to this size fit into an empty pipe on every system we target, so they are written directly into a pipe
+
+#define INPUT_BLOCK 65536 // > block size for reading commands from a regular file (e.g. ./minishell < script)
+#define LIMIT_COUNT 6 // > number of resources that can be limited with ulimit / limit, see limit_options[]
+#define MAX_PROCSUBS 16  // > maximum number of process substitutions <(cmd) or >(cmd) within one command
+#define MAX_JOBS 16      // > maximum number of coprocesses running at the same time
+#define JOB_NAME_MAX 32
+#define MAX_BUILTINS 64  // > native built-ins and built-ins loaded with `enable -f`
+#define SPLICE_BLOCK 65536 // > bytes per splice() / tee() call of the built-ins cat and tee, the default size of a pipe
+#define MAX_CACHE_ENV 16 // > maximum number of `cache --env NAME` variables that are part of the key
+#define MAX_COMMANDS 256 // > resolved command paths in command_cache[]
+#define MAX_HISTORY 1000 // > input lines kept for `history`, the oldest one is dropped first
+#define MAX_EXPORTS 64   // > variables set with `export` in this session
+#define MAX_CAPTURES 8   // > commands whose output is kept for `last`
+#define CAPTURE_MAX_BYTES (4 * 1024 * 1024) // > output kept per command, older output is overwritten
+
 #define DEBUG 0 // if you want to disable the debug messages, just change this to 0
 
 int last_status = 0;  // Memory for return value
 volatile sig_atomic_t child_count = 0;  // Track number of child processes
 
+// Process substitutions of one command: the children and the pipe ends that the command gets as /dev/fd/N
+struct procsub_list {
+    int count;
+    pid_t pids[MAX_PROCSUBS];
+    int fds[MAX_PROCSUBS];
+    char paths[MAX_PROCSUBS][32]; // > "/dev/fd/N", args[] points into this array
+};
+
+/*
+ * Input buffer for stdin of the shell. stdin is shared with the children, so the shell may only read ahead
+ * if it can give the bytes back: for a regular file the unread rest is returned with lseek() before a child starts.
+ */
+struct input_buffer {
+    char data[INPUT_BLOCK];
+    size_t start, end;  // > data[start..end) is read from stdin but not yet consumed by the shell
+    int mode;           // > 0 = not checked yet, see INPUT_* below
+};
+#define INPUT_SEEKABLE 1 // > regular file: read large blocks, rewind before a child runs
+#define INPUT_TTY 2      // > terminal: read() returns at most one line, so nothing is read ahead
+#define INPUT_PIPE 3     // > pipe or socket: read byte by byte, so a child sees every byte after the current line
+
+struct input_buffer shell_input = { .start = 0, .end = 0, .mode = 0 };
+
+int sigchld_pipe[2] = { -1, -1 }; // > self-pipe: the SIGCHLD handler writes a byte, so poll() wakes up when a child ends
+
+// Resources for `ulimit` and `limit`: option letter, resource for setrlimit() and the unit of the value in bytes
+struct limit_option {
+    char flag;
+    int resource;
+    rlim_t unit;
+    const char *description;
+};
+
+struct limit_option limit_options[LIMIT_COUNT] = {
+    { 'c', RLIMIT_CORE,   1024, "core file size (kbytes)" },
+    { 'f', RLIMIT_FSIZE,  1024, "file size (kbytes)" },
+    { 'n', RLIMIT_NOFILE, 1,    "open files" },
+    { 't', RLIMIT_CPU,    1,    "cpu time (seconds)" },
+    { 'u', RLIMIT_NPROC,  1,    "max user processes" },
+    { 'v', RLIMIT_AS,     1024, "virtual memory (kbytes)" },
+};
+
+/*
+ * Capture of the output of a pipeline: stdout of the last command and stderr of all commands go into two pipes.
+ * While waiting for the pipeline the shell reads them, passes the data on to its own stdout / stderr and gives
+ * a copy to sink() (e.g. the files of the `cache` store).
+ */
+struct output_capture {
+    int fds[2]; // > read ends for stdout and stderr, -1 after EOF
+    void (*sink)(struct output_capture *capture, int stream, const char *data, size_t len); // > stream 0 = stdout, 1 = stderr
+    void *context; // > data of the sink
+    struct output_capture *next; // > another capture that gets a copy too (e.g. `cache` while `capture on`), its fds are not used
+};
+
+// Options for running one pipeline, given by prefix built-ins like `timeout` and `limit`
+struct exec_options {
+    double timeout;    // > seconds until the process group gets SIGTERM, 0 = no timeout
+    double kill_after; // > seconds after SIGTERM until SIGKILL, 0 = never
+    int limit_count;   // > resource limits, set in every child before exec
+    int limit_resources[LIMIT_COUNT];
+    rlim_t limit_values[LIMIT_COUNT];
+    struct output_capture *capture; // > NULL = the output goes directly to the stdout / stderr of the shell
+};
+
+/*
+ * Job table for the coprocesses. A coprocess runs in the background, the shell keeps the write end of its stdin
+ * and the read end of its stdout. Both fds have FD_CLOEXEC set, a command only gets them with >&NAME / <&NAME,
+ * otherwise every command would hold the stdin of the coprocess open and it would never see EOF.
+ */
+struct job {
+    char name[JOB_NAME_MAX];
+    pid_t pid;   // > 0 = free slot
+    int to_fd;   // > write end: stdin of the coprocess
+    int from_fd; // > read end: stdout of the coprocess
+};
+
+struct job jobs[MAX_JOBS];
+
+/*
+ * Table of the built-ins that run inside the shell process. The native ones (exit, cd, ret, ...) and the ones loaded
+ * with `enable -f` have the same signature (see minishell_builtin.h), so they are dispatched the same way.
+ */
+struct builtin {
+    char name[JOB_NAME_MAX];
+    minishell_builtin_fn *handler;
+    void *library; // > handle of dlopen(), NULL for a native built-in
+    int forked;    // > 1 = always runs in a forked child without exec (cat, tee), they may block on stdin for a long time
+};
+
+int exit_requested = 0; // > set by the built-in exit, shell_functionality() then ends the shell
+
+/*
+ * Resolved paths of commands (like `hash` in bash). The shell searches PATH once per name before fork(),
+ * the child then calls execv() with the stored path instead of searching PATH again with execvp().
+ */
+struct command_path {
+    char name[JOB_NAME_MAX];
+    char path[PATH_MAX];
+};
+
+struct command_path command_cache[MAX_COMMANDS];
+int command_cache_count = 0;
+
+char *history[MAX_HISTORY]; // > input lines, oldest first
+int history_count = 0;
+
+char *exported[MAX_EXPORTS]; // > names of the variables set with `export`, they are saved in the session snapshot
+int exported_count = 0;
+
+/*
+ * Output of the last commands for `last` (opt-in with `capture on`). Each command has a memfd, which is used as
+ * a ring of CAPTURE_MAX_BYTES: when the output is larger, the oldest bytes are overwritten.
+ * There is one slot more than MAX_CAPTURES: the running command writes into the free one, so `last | grep`
+ * can still read every command that `last` shows.
+ */
+struct captured_command {
+    int fd;         // > memfd with the output (stdout and stderr in the order they arrived), -1 = not created yet
+    char *command;
+    int status;
+    double seconds; // > wall clock time of the command
+    size_t total;   // > bytes of output, more than CAPTURE_MAX_BYTES means the beginning is overwritten
+};
+
+struct captured_command captures[MAX_CAPTURES + 1];
+int capture_enabled = 0;
+int capture_count = 0;   // > finished commands that `last` can show
+int capture_newest = 0;  // > slot of the newest finished command
+
+struct builtin *find_builtin(const char *name);
+
+void handle_multi_pipe(char *input, struct exec_options *opts);
+
 /*
  * Displays the current path as shell prompt.
  * This loop splits the current working directory path by '/'.
@@ -62,25 +237,13 @@ void print_prompt() {
     }
 }
 
-// Check if process has children without blocking
+/*
+ * Check if process has children without blocking.
+ * The children are not reaped here: every child is waited for with waitpid() by the function that started it,
+ * otherwise the signal handler could steal the exit status of a foreground command or a process substitution.
+ */
 int has_children() {
-    pid_t result = waitpid(-1, NULL, WNOHANG);
-    
-    if (result > 0) {
-        // Child process was reaped, decrement counter
-        if (child_count > 0) child_count--;
-        return (child_count > 0);
-    } else if (result == 0) {
-        // Children exist but none have terminated
-        return (child_count > 0);
-    } else if (result == -1 && errno == ECHILD) {
-        // No children exist
-        child_count = 0;
-        return 0;
-    } else {
-        // Error occurred, assume no children
-        return 0;
-    }
+    return (child_count > 0);
 }
 
 // Signal handling for Ctrl+C
@@ -100,6 +263,40 @@ void handle_sigint(int sig) {
     }
 }
 
+// Signal handling for SIGCHLD: only wakes up wait_for_pipeline(), the children are reaped there
+void handle_sigchld(int sig) {
+    int saved_errno = errno; // > write() may change errno of the interrupted code
+    if (sigchld_pipe[1] != -1) {
+        ssize_t n = write(sigchld_pipe[1], "c", 1); // > if the pipe is full, there is already a wake-up pending
+        (void)n;
+    }
+    errno = saved_errno;
+    (void)sig;
+}
+
+// Creates the SIGCHLD self-pipe and installs handle_sigchld(), used by wait_for_pipeline() to wait with a timeout
+void open_sigchld_pipe() {
+    if (pipe(sigchld_pipe) == 0) {
+        for (int i = 0; i < 2; i++) {
+            fcntl(sigchld_pipe[i], F_SETFL, O_NONBLOCK);
+            fcntl(sigchld_pipe[i], F_SETFD, FD_CLOEXEC);
+        }
+    }
+    signal(SIGCHLD, handle_sigchld);
+}
+
+/*
+ * Called first in every forked child: the self-pipe belongs to the parent. A sub-shell closes the inherited fds
+ * and the next pipe() gets the same numbers, the handler would then write its byte into a pipe with user data.
+ */
+void close_sigchld_pipe() {
+    signal(SIGCHLD, SIG_DFL);
+    for (int i = 0; i < 2; i++) {
+        if (sigchld_pipe[i] >= 0) close(sigchld_pipe[i]);
+        sigchld_pipe[i] = -1;
+    }
+}
+
 // Display of last return value
 void handle_sighup(int sig) {
     if(sig == 0) {
@@ -110,6 +307,67 @@ void handle_sighup(int sig) {
     fflush(stdout);
 }
 
+/*
+ * Reads the next line from stdin into *line (like getline(), the buffer grows if needed).
+ * stdio (fgets) cannot be used here, because it reads ahead and the children would miss these bytes.
+ * Returns the length of the line including '\n', or -1 on EOF when nothing was read.
+ */
+ssize_t read_input_line(char **line, size_t *cap) {
+    struct input_buffer *in = &shell_input;
+    if (in->mode == 0) {
+        struct stat st;
+        if (fstat(STDIN_FILENO, &st) == 0 && S_ISREG(st.st_mode)) in->mode = INPUT_SEEKABLE;
+        else if (isatty(STDIN_FILENO)) in->mode = INPUT_TTY;
+        else in->mode = INPUT_PIPE;
+    }
+
+    size_t len = 0;
+    while (1) {
+        if (in->start == in->end) {
+            // > on a pipe only one byte is requested, so we never take bytes that belong to the next command
+            size_t want = (in->mode == INPUT_PIPE) ? 1 : sizeof(in->data);
+            ssize_t n = read(STDIN_FILENO, in->data, want);
+            if (n == -1 && errno == EINTR) continue;
+            if (n <= 0) break; // EOF or error
+            in->start = 0;
+            in->end = n;
+        }
+
+        char *newline = memchr(in->data + in->start, '\n', in->end - in->start);
+        size_t take = newline ? (size_t)(newline - (in->data + in->start)) + 1 : in->end - in->start;
+
+        if (len + take + 1 > *cap) {
+            size_t new_cap = *cap ? *cap : MAX_LINE;
+            while (len + take + 1 > new_cap) new_cap *= 2;
+            char *bigger = realloc(*line, new_cap);
+            if (!bigger) return -1;
+            *line = bigger;
+            *cap = new_cap;
+        }
+        memcpy(*line + len, in->data + in->start, take);
+        len += take;
+        in->start += take;
+        if (newline) break;
+    }
+
+    if (len == 0) return -1;
+    (*line)[len] = '\0';
+    return len;
+}
+
+/*
+ * Gives the bytes that the shell has read ahead back to stdin, before a child is started.
+ * Children share the file offset of stdin with the shell, so after lseek() a child like `wc` reads exactly
+ * the input after the current command, and the shell continues after whatever the child consumed.
+ */
+void sync_input() {
+    struct input_buffer *in = &shell_input;
+    if (in->mode == INPUT_SEEKABLE && in->start < in->end) {
+        lseek(STDIN_FILENO, -(off_t)(in->end - in->start), SEEK_CUR);
+    }
+    in->start = in->end = 0;
+}
+
 /*
  * Splits an input line into arguments for command execution.
  * The input_line is split into tokens by space character (' ').
@@ -138,243 +396,2651 @@ char **parse_input(char *input_line) {
     return args;    // > args will be freed later after it is not being used anymore, especially in main!
 }
 
+// Creates an anonymous file in memory (memfd) with FD_CLOEXEC, returns -1 on error
+int memory_fd(const char *name) {
+#ifdef __linux__
+    int fd = memfd_create(name, MFD_CLOEXEC);
+#else
+    // > macOS has no memfd_create(), tmpfile() gives us an already unlinked file instead
+    (void)name;
+    FILE *tmp = tmpfile();
+    int fd = tmp ? dup(fileno(tmp)) : -1;
+    if (tmp) fclose(tmp);
+    if (fd != -1) fcntl(fd, F_SETFD, FD_CLOEXEC);
+#endif
+    if (fd == -1) perror("memfd_create failed");
+    return fd;
+}
+
+// Creates a pipe whose both ends have FD_CLOEXEC, returns -1 on error
+int pipe_cloexec(int fds[2]) {
+#ifdef __linux__
+    return pipe2(fds, O_CLOEXEC); // > atomic, no other thread can fork() in between
+#else
+    // > macOS has no pipe2(), the flag is set afterwards
+    if (pipe(fds) == -1) return -1;
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return 0;
+#endif
+}
+
 /*
- * Handles the pipe between two or more programs
- * The pipe() system call creates a unidirectional communication channel.
- * For N piped commands, N-1 pipes are needed to transfer data from one command to the next.
- * Each pipe consists of a read and write end (pipefd[0] and pipefd[1]).
- * We use dup2() to redirect stdin and stdout to the appropriate pipe ends.
+ * Creates a file descriptor that returns the given bytes when it is read, so it can be used as stdin of a child.
+ * Small payloads are written directly into a pipe, because they fit into the pipe buffer and the write never blocks.
+ * Larger payloads are stored in an anonymous memory file (memfd_create), so there is no temp file on the disk
+ * and no helper process that has to feed the pipe. The returned fd has FD_CLOEXEC set, the child gets it through dup2().
  */
-void handle_multi_pipe(char *input) {
-    // Split by '|'
-    char *commands[MAX_ARGS];
-    int count = 0;
-    char *saveptr;
+int make_input_fd(const char *data, size_t len) {
+    if (len <= HEREDOC_PIPE_MAX) {
+        int pipefd[2];
+        if (pipe(pipefd) == -1) {
+            perror("pipe failed");
+            return -1;
+        }
+        if (len > 0 && write(pipefd[1], data, len) != (ssize_t)len) {
+            perror("write failed");
+            close(pipefd[0]);
+            close(pipefd[1]);
+            return -1;
+        }
+        close(pipefd[1]); // > close the write end, so that the reader gets EOF after the payload
+        fcntl(pipefd[0], F_SETFD, FD_CLOEXEC);
+        return pipefd[0];
+    }
 
-    char *token = strtok_r(input, "|", &saveptr);
-    while (token && count < MAX_ARGS) {
-        while (*token == ' ') token++; // skip leading spaces
-        if (*token == '\0') {
-            fprintf(stderr, "Error: Empty command between pipes not allowed.\n");
-            return;
+    int fd = memory_fd("minishell-heredoc");
+    if (fd == -1) return -1;
+
+    size_t written = 0;
+    while (written < len) {
+        ssize_t n = write(fd, data + written, len - written);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            perror("write failed");
+            close(fd);
+            return -1;
         }
-        commands[count++] = token;
-        token = strtok_r(NULL, "|", &saveptr);
+        written += n;
     }
+    lseek(fd, 0, SEEK_SET); // > rewind, so that the child reads the payload from the beginning
+    return fd;
+}
 
-    if (count == 0) {
-        fprintf(stderr, "Error: No valid command detected.\n");
-        return;
+/*
+ * Here-document bodies that were read before the command runs (see prefetch_heredocs()).
+ * read_heredoc_body() hands them out in order instead of reading stdin again.
+ */
+struct heredoc_body {
+    char *data;
+    size_t len;
+    struct heredoc_body *next;
+};
+
+struct heredoc_body *prefetched_bodies = NULL;
+int prefetching_heredocs = 0; // > while set, read_heredoc_body() keeps a copy of every body it reads
+
+/*
+ * Reads the body of a here-document from stdin, line by line, until a line equals the delimiter.
+ * With strip_tabs (<<-EOF) leading tabs are removed from every line, like in other shells.
+ * Returns the body in the heap memory (must be freed by the caller) and its length in len.
+ */
+char *read_heredoc_body(const char *delim, int strip_tabs, size_t *len) {
+    if (prefetched_bodies && !prefetching_heredocs) {
+        struct heredoc_body *next = prefetched_bodies;
+        char *data = next->data;
+        *len = next->len;
+        prefetched_bodies = next->next;
+        free(next);
+        return data;
     }
 
-    // If original input starts or ends with '|', reject
-    size_t len = strlen(input);
-    if (input[0] == '|' || input[len - 1] == '|') {
-        // > after I learn in the Uebung 6, I think it is better if I just set an error commands for the right one too.
-        fprintf(stderr, "Error: Pipe at beginning or end not allowed.\n");
-        return;
+    size_t cap = MAX_LINE;
+    char *body = malloc(cap);
+    if (!body) return NULL;
+    *len = 0;
+
+    char *line = NULL;
+    size_t line_cap = 0;
+    ssize_t n;
+    while (1) {
+        if (isatty(STDIN_FILENO)) {
+            printf("> "); // > continuation prompt, so that the user knows the shell still waits for the body
+            fflush(stdout);
+        }
+        n = read_input_line(&line, &line_cap);
+        if (n == -1) {
+            fprintf(stderr, "Warning: here-document delimited by end-of-file (wanted '%s').\n", delim);
+            break;
+        }
+
+        char *start = line;
+        if (strip_tabs) {
+            while (*start == '\t') start++;
+            n -= start - line;
+        }
+        size_t content = n;
+        if (content > 0 && start[content - 1] == '\n') content--; // > the last line may come without '\n'
+        if (content == strlen(delim) && strncmp(start, delim, content) == 0) break;
+
+        if (*len + n > cap) {
+            while (*len + n > cap) cap *= 2;
+            char *bigger = realloc(body, cap);
+            if (!bigger) {
+                free(body);
+                free(line);
+                return NULL;
+            }
+            body = bigger;
+        }
+        memcpy(body + *len, start, n);
+        *len += n;
     }
 
-    int **pipes = malloc((count - 1) * sizeof(int *));
-    for (int i = 0; i < count - 1; ++i) {
-        pipes[i] = malloc(2 * sizeof(int));
-        if (pipe(pipes[i]) == -1) {
-            perror("pipe failed");
-            return;
+    free(line);
+    if (prefetching_heredocs) {
+        struct heredoc_body *copy = malloc(sizeof(*copy));
+        if (!copy || !(copy->data = malloc(*len + 1))) { // > +1, so that an empty body is not malloc(0)
+            free(copy);
+            free(body);
+            return NULL;
         }
+        memcpy(copy->data, body, *len);
+        copy->len = *len;
+        copy->next = NULL;
+        struct heredoc_body **tail = &prefetched_bodies;
+        while (*tail) tail = &(*tail)->next;
+        *tail = copy;
     }
+    return body;
+}
 
-    for (int i = 0; i < count; ++i) {
-        char *cmd_copy = strdup(commands[i]); // > copy the value of the commands into cmd_copy, so that it does not corrupt the data!
-        char **args = parse_input(cmd_copy); // > take the command and convert them into string array, so that it could be executed with the given parameter through execv().
+/*
+ * Joins the argument tokens starting at args[i] into one word, if the word is quoted ('...' or "...").
+ * parse_input() splits by spaces, so a quoted here-string like "hello world" arrives as two tokens.
+ * *consumed is set to the number of tokens that belong to the word.
+ */
+char *join_quoted_word(char **args, int i, int *consumed) {
+    char quote = args[i][0];
+    *consumed = 1;
+    if (quote != '\'' && quote != '"') return strdup(args[i]);
 
-        pid_t pid = fork();
-        if (pid == 0) {
-            // > how the dup works https://youtu.be/PIb2aShU_H4?si=WET26X4zSAwlRPhu$0
-            if (i > 0) { // Not first: read from previous pipe
-                dup2(pipes[i - 1][0], STDIN_FILENO);
+    size_t total = 0;
+    int end = i;
+    while (args[end]) {
+        total += strlen(args[end]) + 1;
+        size_t l = strlen(args[end]);
+        if ((end > i || l > 1) && args[end][l - 1] == quote) break;
+        end++;
+    }
+    if (!args[end]) end--; // > no closing quote, take everything until the end
+
+    char *word = malloc(total + 1);
+    if (!word) return NULL;
+    word[0] = '\0';
+    for (int k = i; k <= end; k++) {
+        if (k > i) strcat(word, " ");
+        strcat(word, args[k]);
+    }
+
+    // Remove the surrounding quotes
+    size_t l = strlen(word);
+    if (l > 1 && word[l - 1] == quote) word[--l] = '\0';
+    memmove(word, word + 1, l);
+
+    *consumed = end - i + 1;
+    return word;
+}
+
+/*
+ * Looks for a here-document (<<EOF, <<-EOF) or a here-string (<<< word) within the arguments.
+ * The redirection tokens are removed from args, so that args can be given to execvp() afterwards.
+ * Returns the fd that has to become stdin of the command, -1 if there is no redirection and -2 on error.
+ */
+int extract_heredoc(char **args) {
+    int in_fd = -1;
+
+    for (int i = 0; args[i]; ) {
+        if (strncmp(args[i], "<<", 2) != 0) {
+            i++;
+            continue;
+        }
+
+        int consumed = 1;
+        char *body = NULL;
+        size_t len = 0;
+
+        if (strncmp(args[i], "<<<", 3) == 0) {
+            // Here-string: the word itself followed by a newline
+            char *word;
+            if (args[i][3] != '\0') {
+                word = strdup(args[i] + 3);
+            } else if (args[i + 1]) {
+                int word_tokens;
+                word = join_quoted_word(args, i + 1, &word_tokens);
+                consumed += word_tokens;
+            } else {
+                fprintf(stderr, "Error: Missing word after '<<<'.\n");
+                if (in_fd >= 0) close(in_fd);
+                return -2;
             }
-            if (i < count - 1) { // Not last: write to next pipe
-                dup2(pipes[i][1], STDOUT_FILENO); // > take the Process content of the index pipefd[1] and into the index of STDOUT located, so that the stdout (output) values will be redirected into the pipe.
+            if (!word) return -2;
+            len = strlen(word) + 1;
+            body = malloc(len + 1);
+            if (body) snprintf(body, len + 1, "%s\n", word);
+            free(word);
+        } else {
+            // Here-document: read the following input lines until the delimiter
+            const char *delim = args[i] + 2;
+            int strip_tabs = 0;
+            if (*delim == '-') {
+                strip_tabs = 1;
+                delim++;
+            }
+            if (*delim == '\0') {
+                if (!args[i + 1]) {
+                    fprintf(stderr, "Error: Missing delimiter after '<<'.\n");
+                    if (in_fd >= 0) close(in_fd);
+                    return -2;
+                }
+                delim = args[i + 1];
+                consumed++;
             }
 
-            // Close all pipes in child, because dup2()-functionality: duplicates the file descriptors (see Ueubng 6)
-            for (int j = 0; j < count - 1; ++j) {
-                close(pipes[j][0]);
-                close(pipes[j][1]);
+            // > a quoted delimiter ('EOF' or "EOF") means the same as EOF, as we do not expand anything in the body
+            char delim_copy[MAX_LINE];
+            strncpy(delim_copy, delim, MAX_LINE - 1);
+            delim_copy[MAX_LINE - 1] = '\0';
+            size_t dl = strlen(delim_copy);
+            if (dl > 1 && (delim_copy[0] == '\'' || delim_copy[0] == '"') && delim_copy[dl - 1] == delim_copy[0]) {
+                delim_copy[dl - 1] = '\0';
+                memmove(delim_copy, delim_copy + 1, dl - 1);
             }
+            body = read_heredoc_body(delim_copy, strip_tabs, &len);
+        }
 
-            execvp(args[0], args); // > execvp means execute program with vector (array) as input and uses path to look for the program
-            perror("execv failed");
-            exit(1);
-        } else if (pid > 0) {
-            // Parent process: increment child counter
-            child_count++;
+        if (!body) {
+            fprintf(stderr, "Error: Could not allocate memory for here-document.\n");
+            if (in_fd >= 0) close(in_fd);
+            return -2;
         }
 
-        free(cmd_copy);
-        free(args);
-    }
+        if (in_fd >= 0) close(in_fd); // > like in other shells, the last redirection wins
+        in_fd = make_input_fd(body, len);
+        free(body);
+        if (in_fd < 0) return -2;
 
-    // Close all pipes in parent
-    for (int i = 0; i < count - 1; ++i) {
-        close(pipes[i][0]);
-        close(pipes[i][1]);
-        free(pipes[i]);
+        // Remove the redirection tokens from args (including the terminating NULL)
+        int j = i;
+        do {
+            args[j] = args[j + consumed];
+        } while (args[j++]);
     }
-    free(pipes);
 
-    // Wait for all children
-    int status;
-    for (int i = 0; i < count; ++i) {
-        wait(&status);
-        if (child_count > 0) child_count--;
+    return in_fd;
+}
+
+/*
+ * Reads the bodies of all here-documents in args now, in the order handle_multi_pipe() would read them, and keeps
+ * them in prefetched_bodies. args itself is not changed. Used by `cache`, which needs the bodies for the key before
+ * it knows whether the command runs at all.
+ * Returns 0 on success, -1 on error (the message is already printed).
+ */
+int prefetch_heredocs(char **args) {
+    int count = 0;
+    while (args[count]) count++;
+    char **copy = malloc((count + 1) * sizeof(char *)); // > extract_heredoc() removes the tokens it has handled
+    if (!copy) {
+        fprintf(stderr, "Error: Could not allocate memory for here-document.\n");
+        return -1;
     }
+    memcpy(copy, args, (count + 1) * sizeof(char *));
 
-    if (WIFEXITED(status)) last_status = WEXITSTATUS(status);
-    else last_status = -1;
+    prefetching_heredocs = 1;
+    int fd = extract_heredoc(copy);
+    prefetching_heredocs = 0;
+    free(copy);
+    if (fd >= 0) close(fd);
+    return fd == -2 ? -1 : 0;
 }
 
-// Handles the 'cd' command to change directories
-void handle_cd(char **args)
-{
-    const char *target = args[1] ? args[1] : getenv("HOME");
-    char path[PATH_MAX];
+// Frees the bodies that prefetch_heredocs() has read, but no command has used
+void drop_prefetched_heredocs(void) {
+    while (prefetched_bodies) {
+        struct heredoc_body *next = prefetched_bodies->next;
+        free(prefetched_bodies->data);
+        free(prefetched_bodies);
+        prefetched_bodies = next;
+    }
+}
 
-    if (args[1] && args[1][0] == '~')
-    {
-        const char *home = getenv("HOME");
-        snprintf(path, sizeof(path), "%s%s", home, args[1] + 1); // > if the first character of args[1] is '~', then we take the home directory and concatenate it with the rest of the path.
-        target = path;
+/*
+ * Works like strtok_r(), but a separator inside parentheses does not split the string.
+ * This is needed for process substitution, e.g. `diff <(sort a | uniq) <(sort b)` must not be split at the inner '|'.
+ */
+char *split_top_level(char *input, char sep, char **saveptr) {
+    char *p = input ? input : *saveptr;
+    while (*p == sep) p++; // > skip leading separators like strtok_r() does
+    if (*p == '\0') {
+        *saveptr = p;
+        return NULL;
     }
 
-    if (chdir(target) != 0) // > chdir: change directory to the given path
-    {
-        fprintf(stderr, "cd failed: %s\n", strerror(errno)); // > send a message why it does not work.
-        last_status = 1;
+    char *start = p;
+    int depth = 0;
+    for (; *p; p++) {
+        if (*p == '(') depth++;
+        else if (*p == ')' && depth > 0) depth--;
+        else if (*p == sep && depth == 0) {
+            *p = '\0';
+            *saveptr = p + 1;
+            return start;
+        }
     }
-    else
-    {
-        last_status = 0;
+    *saveptr = p;
+    return start;
+}
+
+// Returns the first c that is not inside parentheses, or NULL
+char *find_top_level(char *input, char c) {
+    int depth = 0;
+    for (char *p = input; *p; p++) {
+        if (*p == '(') depth++;
+        else if (*p == ')' && depth > 0) depth--;
+        else if (*p == c && depth == 0) return p;
     }
+    return NULL;
 }
 
-int shell_functionality(int *retFlag) {
-    *retFlag = 1;
-    print_prompt();
-    char input_line[MAX_LINE];
+/*
+ * Fan-out: `producer |+ consumer1 |+ consumer2` sends the output of producer to every consumer.
+ * It is rewritten to `producer | tee >(consumer1) | consumer2`, the built-in tee duplicates the stream with tee(2).
+ * Each part may be a pipeline itself, |+ binds weaker than |. The return value is the one of the last consumer.
+ * Returns 1 and a new string in *expanded, 0 if there is no |+ or -1 on error.
+ */
+int expand_fanout(const char *input, char **expanded) {
+    const char *parts[MAX_ARGS];
+    size_t lengths[MAX_ARGS];
+    int count = 0;
+    int depth = 0;
+    const char *start = input;
+    for (const char *p = input; ; p++) {
+        if (*p == '(') depth++;
+        else if (*p == ')' && depth > 0) depth--;
+        else if ((*p == '\0' || (p[0] == '|' && p[1] == '+' && depth == 0)) && count < MAX_ARGS) {
+            const char *end = p;
+            while (*start == ' ') start++;
+            while (end > start && end[-1] == ' ') end--;
+            parts[count] = start;
+            lengths[count++] = end - start;
+            if (*p == '\0') break;
+            start = ++p + 1; // > skip "|+"
+        }
+        if (*p == '\0') break;
+    }
+    if (count < 2) return 0;
 
-    if (!fgets(input_line, MAX_LINE, stdin))
-    {
-        printf("\n");
-        return 0; // EOF
+    size_t size = 32;
+    for (int i = 0; i < count; i++) {
+        if (lengths[i] == 0) {
+            fprintf(stderr, "Error: Empty command at |+ not allowed.\n");
+            return -1;
+        }
+        size += lengths[i] + 8;
     }
 
-    input_line[strcspn(input_line, "\n")] = '\0'; // > change at the end of the line of the code
-    if(DEBUG) printf("[DEBUG] shell_functionality, Input line: '%s'\n", input_line); // > for debugging purpose, so that I can see what is being given as input
-    char *saveptr;
-    char *command = strtok_r(input_line, ";", &saveptr); // > collect the collection of Strings of command, especially if there is ";"
+    char *result = malloc(size);
+    if (!result) return -1;
+    int len = snprintf(result, size, "%.*s | tee", (int)lengths[0], parts[0]);
+    for (int i = 1; i < count - 1; i++) {
+        len += snprintf(result + len, size - len, " >(%.*s)", (int)lengths[i], parts[i]);
+    }
+    snprintf(result + len, size - len, " | %.*s", (int)lengths[count - 1], parts[count - 1]);
+    *expanded = result;
+    return 1;
+}
 
-    // > The `;` is being used as the iterator through the commands that might be within the command#s array
-    // execute each command in the input line e.g. `ls; pwd; echo "Hello World"; cd /tmp`
-    // it executes ls first, then pwd, then echo "Hello World", and finally cd /tmp
-    while (command)
-    {
-        while (*command == ' ')
-            command++; // > if within the char array there are blank space, then skip it and go to the next character!
+// Returns the resolved path of the command name, or NULL if it is not in command_cache[]
+const char *lookup_command(const char *name) {
+    for (int i = 0; i < command_cache_count; i++) {
+        if (strcmp(command_cache[i].name, name) == 0) return command_cache[i].path;
+    }
+    return NULL;
+}
 
-        char *command_copy = strdup(command); // > copy the command into command_copy in the heap_memorry, so that it does not affect the pointer variable command when we are passing other value to other function.
-        if (!command_copy)
-        {
-            fprintf(stderr, "Error: Could not allocate memory for command.\n");
-            break;
-        }
+// Stores a resolved path in command_cache[], if the table is full the name is just not cached
+void remember_command(const char *name, const char *path) {
+    if (command_cache_count == MAX_COMMANDS || strlen(name) >= JOB_NAME_MAX || strlen(path) >= PATH_MAX) return;
+    struct command_path *entry = &command_cache[command_cache_count++];
+    snprintf(entry->name, sizeof(entry->name), "%s", name);
+    snprintf(entry->path, sizeof(entry->path), "%s", path);
+}
 
-        // Detect pipe command
-        char *pipe = strchr(command, '|');
-        if (pipe)
-        {
-            handle_multi_pipe(command);
-            command = strtok_r(NULL, ";", &saveptr); // > go to to the next available command, take the pointer to the next command.
-            continue;                                // > For the next command, we go back and see if there is Pipe or simmilar.
+/*
+ * Searches the command name in PATH like execvp() and remembers the result in command_cache[].
+ * Relative entries of PATH (e.g. "." or "") are not cached, their result depends on the working directory.
+ * Called in the parent before fork(), so that every later child finds it with lookup_command().
+ */
+void resolve_command(const char *name) {
+    const char *path_env = getenv("PATH");
+    if (strchr(name, '/') || lookup_command(name) || !path_env) return;
+
+    char dirs[PATH_MAX * 4];
+    snprintf(dirs, sizeof(dirs), "%s", path_env);
+    char *saveptr;
+    for (char *dir = strtok_r(dirs, ":", &saveptr); dir; dir = strtok_r(NULL, ":", &saveptr)) {
+        if (dir[0] != '/') return; // > execvp() would find it here first, so nothing further on may be cached
+        char candidate[PATH_MAX + JOB_NAME_MAX + 2];
+        struct stat st;
+        snprintf(candidate, sizeof(candidate), "%s/%s", dir, name);
+        if (stat(candidate, &st) == 0 && S_ISREG(st.st_mode) && access(candidate, X_OK) == 0) {
+            remember_command(name, candidate);
+            return;
         }
+    }
+}
 
-        char **args = parse_input(command_copy); // > take the command and convert them into string array, so that it could be executed with the given parameter through execv().
-        if (!args || !args[0])
+/*
+ * Replaces the current (child) process with the program in args.
+ * If the command contains a '/', it is treated as a path, otherwise PATH is searched.
+ */
+void exec_command(char **args) {
+    if(DEBUG) printf("[DEBUG] Executing command: %s, with strchr: %s\n", args[0], strchr(args[0], '/'));
+    if (strchr(args[0], '/') != NULL) {
+        execv(args[0], args);  // exact path
+        perror("execv failed");
+    } else {
+        const char *path = lookup_command(args[0]);
+        if (path) execv(path, args); // > resolved before, if the program was removed since then PATH is searched again
+        execvp(args[0], args); // search PATH
+        perror("execvp failed");
+    }
+    exit(1);
+}
+
+/*
+ * Closes every inherited fd except stdin, stdout and stderr.
+ * A process substitution child must not keep the pipe ends of the surrounding pipeline open,
+ * otherwise the next command in that pipeline never sees EOF.
+ */
+void close_inherited_fds() {
+    int fds[MAX_ARGS * 4];
+    int count = 0;
+    DIR *dir = opendir("/dev/fd");
+    if (!dir) return;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) && count < MAX_ARGS * 4) {
+        int fd = atoi(entry->d_name);
+        if (fd > STDERR_FILENO && fd != dirfd(dir)) fds[count++] = fd;
+    }
+    closedir(dir); // > close the directory first, because its own fd is in the list of /dev/fd
+    for (int i = 0; i < count; i++) close(fds[i]);
+}
+
+/*
+ * Runs a command line in an already forked child and never returns (used for process substitutions and coprocesses).
+ * The child works like a small shell that starts the commands and waits for them. Also a simple command goes
+ * through handle_multi_pipe(), so that <<EOF, <<< and <&X / >&X work inside <(...) and coproc.
+ */
+void run_in_child(char *command_line) {
+    open_sigchld_pipe(); // > its own self-pipe, created after close_inherited_fds()
+    char *saveptr;
+    char *command = split_top_level(command_line, ';', &saveptr);
+    while (command) {
+        handle_multi_pipe(command, NULL); // > a single command is a pipeline with one stage
+        command = split_top_level(NULL, ';', &saveptr);
+    }
+    exit(last_status);
+}
+
+/*
+ * Starts the command of a process substitution in its own child, connected by a pipe.
+ * For '<' the child writes into the pipe and the consumer reads /dev/fd/N,
+ * for '>' the consumer writes into /dev/fd/N and the child reads it as stdin.
+ * Returns the pid of the child and stores the end of the pipe for the consumer in *fd.
+ * With pgid (a job with timeout) the child joins that process group, or starts it if *pgid is still 0.
+ */
+pid_t start_process_substitution(char *inner, char direction, int *fd, pid_t *pgid) {
+    int pipefd[2];
+    if (pipe(pipefd) == -1) {
+        perror("pipe failed");
+        return -1;
+    }
+
+    sync_input();
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed");
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return -1;
+    }
+
+    if (pid == 0) {
+        close_sigchld_pipe();
+        if (pgid) setpgid(0, *pgid); // > 0: it becomes the leader of the group of the job
+        if (direction == '<') dup2(pipefd[1], STDOUT_FILENO);
+        else dup2(pipefd[0], STDIN_FILENO);
+        close_inherited_fds();
+        run_in_child(inner);
+    }
+
+    // Parent: keep only the end of the pipe that is given to the consumer
+    child_count++;
+    if (pgid) {
+        if (*pgid == 0) *pgid = pid;
+        setpgid(pid, *pgid); // > also done in the parent, so that killpg() works even if the child has not run yet
+    }
+    if (direction == '<') {
+        close(pipefd[1]);
+        *fd = pipefd[0];
+    } else {
+        close(pipefd[0]);
+        *fd = pipefd[1];
+    }
+    return pid;
+}
+
+/*
+ * Looks for process substitutions <(cmd) and >(cmd) within the arguments.
+ * parse_input() has split them by spaces, so the tokens are joined again until the parentheses are balanced.
+ * Every substitution is started immediately and replaced in args by the path /dev/fd/N of its pipe end.
+ * Returns 0 on success and -1 on error (already started substitutions are still in subs and must be finished).
+ */
+int expand_process_substitutions(char **args, struct procsub_list *subs, pid_t *pgid) {
+    subs->count = 0;
+
+    for (int i = 0; args[i]; i++) {
+        if ((args[i][0] != '<' && args[i][0] != '>') || args[i][1] != '(') continue;
+
+        if (subs->count == MAX_PROCSUBS) {
+            fprintf(stderr, "Error: Too many process substitutions (max %d).\n", MAX_PROCSUBS);
+            return -1;
+        }
+
+        // Join the tokens of the inner command until the closing parenthesis
+        char inner[MAX_LINE] = "";
+        int depth = 0;
+        int end = i;
+        for (; args[end]; end++) {
+            if (end > i) strncat(inner, " ", sizeof(inner) - strlen(inner) - 1);
+            strncat(inner, args[end], sizeof(inner) - strlen(inner) - 1);
+            for (char *c = args[end]; *c; c++) {
+                if (*c == '(') depth++;
+                else if (*c == ')') depth--;
+            }
+            if (depth <= 0) break;
+        }
+        size_t len = strlen(inner);
+        if (depth != 0 || inner[len - 1] != ')') {
+            fprintf(stderr, "Error: Missing ')' in process substitution.\n");
+            return -1;
+        }
+        inner[len - 1] = '\0'; // > remove the closing parenthesis
+
+        int fd;
+        pid_t pid = start_process_substitution(inner + 2, args[i][0], &fd, pgid);
+        if (pid < 0) return -1;
+
+        subs->pids[subs->count] = pid;
+        subs->fds[subs->count] = fd;
+        snprintf(subs->paths[subs->count], sizeof(subs->paths[0]), "/dev/fd/%d", fd);
+        args[i] = subs->paths[subs->count];
+        subs->count++;
+
+        // Remove the joined tokens from args (including the terminating NULL)
+        int consumed = end - i;
+        if (consumed > 0) {
+            int j = i + 1;
+            do {
+                args[j] = args[j + consumed];
+            } while (args[j++]);
+        }
+    }
+    return 0;
+}
+
+// Closes the pipe ends of the shell, after the consumer of the process substitutions has been started
+void close_process_substitutions(struct procsub_list *subs) {
+    for (int i = 0; i < subs->count; i++) {
+        if (subs->fds[i] >= 0) close(subs->fds[i]);
+        subs->fds[i] = -1;
+    }
+}
+
+// Waits for the children of the process substitutions, so that no zombie processes are left behind
+void reap_process_substitutions(struct procsub_list *subs) {
+    close_process_substitutions(subs);
+    for (int i = 0; i < subs->count; i++) {
+        while (waitpid(subs->pids[i], NULL, 0) == -1 && errno == EINTR);
+        if (child_count > 0) child_count--;
+    }
+    subs->count = 0;
+}
+
+// Seconds of the monotonic clock, which is not affected when the system time is changed
+double monotonic_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// True if the shell runs in the foreground of a terminal, then a job with its own process group needs the terminal
+int shell_owns_terminal() {
+    return isatty(STDIN_FILENO) && tcgetpgrp(STDIN_FILENO) == getpgrp();
+}
+
+// Gives the terminal to the process group pgid (SIGTTOU is ignored, otherwise a background caller would be stopped)
+void set_terminal_owner(pid_t pgid) {
+    void (*old_handler)(int) = signal(SIGTTOU, SIG_IGN);
+    tcsetpgrp(STDIN_FILENO, pgid);
+    signal(SIGTTOU, old_handler);
+}
+
+/*
+ * Reads one block from the capture pipe of stream (0 = stdout, 1 = stderr), writes it to the same stream of the
+ * shell and hands a copy to the sink (and the sinks of the next captures). At EOF the pipe is closed and its fd set to -1.
+ */
+void pump_capture(struct output_capture *capture, int stream) {
+    char buffer[INPUT_BLOCK];
+    ssize_t n = read(capture->fds[stream], buffer, sizeof(buffer));
+    if (n < 0 && errno == EINTR) return;
+    if (n <= 0) {
+        close(capture->fds[stream]);
+        capture->fds[stream] = -1;
+        return;
+    }
+
+    int out = stream == 0 ? STDOUT_FILENO : STDERR_FILENO;
+    for (ssize_t done = 0; done < n; ) {
+        ssize_t written = write(out, buffer + done, n - done);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) break; // > e.g. stdout closed, the copy for the sink is still complete
+        done += written;
+    }
+    for (struct output_capture *c = capture; c; c = c->next) {
+        if (c->sink) c->sink(c, stream, buffer, (size_t)n);
+    }
+}
+
+/*
+ * Reads what is already in the capture pipes without waiting for more, then closes them. Used when every command
+ * of the pipeline has ended: a background process that inherited stdout or stderr may keep the write end open
+ * for a long time, the shell must not wait for its EOF.
+ */
+void drain_capture(struct output_capture *capture) {
+    for (int round = 0; round < 16; round++) { // > a few blocks per pipe, a writer in the background may never stop
+        struct pollfd pfds[2] = {
+            { .fd = capture->fds[0], .events = POLLIN },
+            { .fd = capture->fds[1], .events = POLLIN },
+        };
+        if (poll(pfds, 2, 0) <= 0) break; // > timeout 0: nothing more is there right now
+        for (int stream = 0; stream < 2; stream++) {
+            if (pfds[stream].fd >= 0 && pfds[stream].revents) pump_capture(capture, stream);
+        }
+    }
+    for (int stream = 0; stream < 2; stream++) {
+        if (capture->fds[stream] >= 0) close(capture->fds[stream]);
+        capture->fds[stream] = -1;
+    }
+}
+
+/*
+ * Waits for the children of one pipeline and returns the exit code for last_status (of the last command).
+ * Without a timeout this is a plain waitpid() for every pid.
+ * With a timeout the shell sleeps in poll() on the SIGCHLD self-pipe until a child ends or the monotonic deadline
+ * is reached. Then the whole process group gets SIGTERM, and with kill_after also SIGKILL after the second deadline.
+ * Like timeout(1) the exit code is 124 after SIGTERM and 137 (128 + 9) after SIGKILL.
+ * With an output capture the same poll() also waits for the capture pipes. They are read until EOF or until every
+ * command has ended, then drain_capture() takes the rest that is already in them.
+ */
+int wait_for_pipeline(pid_t *pids, int count, pid_t pgid, struct exec_options *opts) {
+    int remaining = 0;
+    for (int i = 0; i < count; i++) {
+        if (pids[i] > 0) remaining++;
+    }
+
+    int status = (count > 0 && pids[count - 1] > 0) ? 0 : 1 << 8; // > fork of the last command failed, same as exit(1)
+    int signal_sent = 0;
+    double deadline = (opts && opts->timeout > 0) ? monotonic_now() + opts->timeout : 0;
+    struct output_capture *capture = opts ? opts->capture : NULL;
+
+    while (remaining > 0 || (capture && (capture->fds[0] >= 0 || capture->fds[1] >= 0))) {
+        // Reap every child that has ended, without a deadline or capture waitpid() just blocks
+        int blocking = deadline == 0 && !capture;
+        for (int i = 0; i < count; i++) {
+            if (pids[i] <= 0) continue;
+            int child_status;
+            pid_t result = waitpid(pids[i], &child_status, blocking ? 0 : WNOHANG);
+            if (result == 0) continue; // > still running
+            if (result == -1 && errno == EINTR) {
+                i--; // > interrupted by a signal, wait for the same child again
+                continue;
+            }
+            if (result == pids[i] && i == count - 1) status = child_status;
+            pids[i] = 0;
+            remaining--;
+            if (child_count > 0) child_count--;
+        }
+        if (blocking) continue;
+        if (remaining == 0) {
+            if (capture) drain_capture(capture);
+            break;
+        }
+
+        int timeout_ms = -1;
+        if (remaining > 0 && deadline > 0) {
+            double left = deadline - monotonic_now();
+            if (left <= 0) {
+                // Deadline reached: first SIGTERM, then (with -k) SIGKILL
+                if (!signal_sent) {
+                    if(DEBUG) printf("[DEBUG] Timeout: sending SIGTERM to process group %d\n", pgid);
+                    killpg(pgid, SIGTERM);
+                    killpg(pgid, SIGCONT); // > a stopped process would not handle SIGTERM
+                    signal_sent = SIGTERM;
+                    deadline = (opts->kill_after > 0) ? monotonic_now() + opts->kill_after : 0;
+                } else {
+                    killpg(pgid, SIGKILL);
+                    signal_sent = SIGKILL;
+                    deadline = 0;
+                }
+                continue;
+            }
+            timeout_ms = (int)(left * 1000) + 1; // > +1 ms, so that we do not wake up just before the deadline
+        }
+
+        struct pollfd pfds[3] = {
+            { .fd = sigchld_pipe[0], .events = POLLIN },
+            { .fd = capture ? capture->fds[0] : -1, .events = POLLIN }, // > poll() ignores negative fds
+            { .fd = capture ? capture->fds[1] : -1, .events = POLLIN },
+        };
+        if (poll(pfds, 3, timeout_ms) > 0) {
+            for (int stream = 0; stream < 2; stream++) {
+                if (pfds[stream + 1].fd >= 0 && pfds[stream + 1].revents) pump_capture(capture, stream);
+            }
+        }
+        char drain[64];
+        while (read(sigchld_pipe[0], drain, sizeof(drain)) > 0);
+    }
+
+    if (signal_sent == SIGKILL) return 128 + SIGKILL;
+    if (signal_sent == SIGTERM) return 124;
+    // > see this reference for more information about WIFEXITED https://www.ibm.com/docs/xl-fortran-aix/16.1.0?topic=procedures-wifexitedstat-val
+    // > Reason: WIFEXITED if the process is not exited, then it will return 0, otherwise it will return non zero value
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// Returns the entry of limit_options[] for an option letter like 'v', or NULL
+struct limit_option *find_limit_option(char flag) {
+    for (int i = 0; i < LIMIT_COUNT; i++) {
+        if (limit_options[i].flag == flag) return &limit_options[i];
+    }
+    return NULL;
+}
+
+// Parses a limit value ("unlimited" or a number in the unit of the option). Returns 0 on success, -1 otherwise.
+int parse_limit_value(const char *text, struct limit_option *option, rlim_t *value) {
+    if (strcmp(text, "unlimited") == 0) {
+        *value = RLIM_INFINITY;
+        return 0;
+    }
+    char *end;
+    errno = 0;
+    unsigned long long number = strtoull(text, &end, 10);
+    if (end == text || *end != '\0' || errno != 0 || text[0] == '-') return -1;
+    if (number > (unsigned long long)RLIM_INFINITY / option->unit) return -1; // > would overflow
+    *value = (rlim_t)number * option->unit;
+    return 0;
+}
+
+/*
+ * Sets the resource limits of opts for the current (child) process, called after fork() and before exec.
+ * Soft and hard limit are both set, so the command cannot raise them again. The shell itself is not changed.
+ * Returns 0 on success, -1 if a limit could not be set.
+ */
+int apply_limits(struct exec_options *opts) {
+    for (int i = 0; i < opts->limit_count; i++) {
+        struct rlimit rl;
+        rlim_t value = opts->limit_values[i];
+        if (getrlimit(opts->limit_resources[i], &rl) == 0 && rl.rlim_max != RLIM_INFINITY
+            && (value == RLIM_INFINITY || value > rl.rlim_max)) {
+            value = rl.rlim_max; // > without root a limit can not go above the hard limit
+        }
+        rl.rlim_cur = value;
+        rl.rlim_max = value;
+        if (setrlimit(opts->limit_resources[i], &rl) != 0) {
+            perror("limit: setrlimit failed");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Returns the running coprocess with this name, or NULL
+struct job *find_job(const char *name) {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (jobs[i].pid > 0 && strcmp(jobs[i].name, name) == 0) return &jobs[i];
+    }
+    return NULL;
+}
+
+/*
+ * Starts `coproc NAME cmd...`: the command runs in the background with its stdin and stdout connected to pipes.
+ * The coprocess gets its own process group, so Ctrl+C for a foreground command does not kill the worker.
+ * args are the words of command_line. Here-documents are read by the shell before the fork: stdin of the
+ * coprocess is the pipe, the body would be read from there and its lines would be run by the shell.
+ * Returns 0 on success, -1 on error.
+ */
+int start_coproc(const char *name, char **args, char *command_line) {
+    if (prefetch_heredocs(args) != 0) { // > also when the coprocess does not start, the body must not stay on stdin
+        drop_prefetched_heredocs();
+        return -1;
+    }
+
+    // > the name is used in >&NAME, so it must not look like a number
+    int valid = (name[0] != '\0' && strlen(name) < JOB_NAME_MAX && !(name[0] >= '0' && name[0] <= '9'));
+    for (const char *c = name; *c; c++) {
+        if (!(*c == '_' || (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9'))) valid = 0;
+    }
+    if (!valid) {
+        fprintf(stderr, "coproc: invalid name '%s'\n", name);
+        drop_prefetched_heredocs();
+        return -1;
+    }
+    if (find_job(name)) {
+        fprintf(stderr, "coproc: '%s' is still running\n", name);
+        drop_prefetched_heredocs();
+        return -1;
+    }
+
+    struct job *job = NULL;
+    for (int i = 0; i < MAX_JOBS && !job; i++) {
+        if (jobs[i].pid == 0) job = &jobs[i];
+    }
+    if (!job) {
+        fprintf(stderr, "coproc: too many coprocesses (max %d)\n", MAX_JOBS);
+        drop_prefetched_heredocs();
+        return -1;
+    }
+
+    int to_child[2], from_child[2];
+    if (pipe(to_child) == -1) {
+        perror("pipe failed");
+        drop_prefetched_heredocs();
+        return -1;
+    }
+    if (pipe(from_child) == -1) {
+        perror("pipe failed");
+        close(to_child[0]);
+        close(to_child[1]);
+        drop_prefetched_heredocs();
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed");
+        drop_prefetched_heredocs();
+        close(to_child[0]);
+        close(to_child[1]);
+        close(from_child[0]);
+        close(from_child[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        close_sigchld_pipe();
+        setpgid(0, 0);
+        dup2(to_child[0], STDIN_FILENO);
+        dup2(from_child[1], STDOUT_FILENO);
+        close_inherited_fds(); // > also the pipes of other coprocesses, so that they still get EOF
+        run_in_child(command_line); // > hands the bodies to the commands, see read_heredoc_body()
+    }
+
+    drop_prefetched_heredocs(); // > the child has its own copy of the bodies
+    setpgid(pid, pid);
+    close(to_child[0]);
+    close(from_child[1]);
+    fcntl(to_child[1], F_SETFD, FD_CLOEXEC);
+    fcntl(from_child[0], F_SETFD, FD_CLOEXEC);
+
+    snprintf(job->name, sizeof(job->name), "%s", name);
+    job->pid = pid;
+    job->to_fd = to_child[1];
+    job->from_fd = from_child[0];
+    printf("[%s] %d\n", name, pid);
+    fflush(stdout);
+    return 0;
+}
+
+// Removes a coprocess from the job table and closes the pipes of the shell
+void remove_job(struct job *job) {
+    if (job->to_fd >= 0) close(job->to_fd);
+    if (job->from_fd >= 0) close(job->from_fd);
+    job->pid = 0;
+    job->to_fd = job->from_fd = -1;
+}
+
+/*
+ * Reaps coprocesses that have ended, without blocking. Called before every prompt,
+ * so a finished coprocess is reported once and does not stay as a zombie.
+ */
+void update_jobs() {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (jobs[i].pid <= 0) continue;
+        int status;
+        pid_t result = waitpid(jobs[i].pid, &status, WNOHANG);
+        if (result == 0) continue; // > still running
+        if (result == jobs[i].pid) {
+            printf("[%s] Done (%d)\n", jobs[i].name, WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+        }
+        remove_job(&jobs[i]);
+    }
+}
+
+// Handles the built-in `jobs`: lists the running coprocesses with their pids
+void handle_jobs() {
+    update_jobs();
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (jobs[i].pid > 0) printf("[%s] %d Running\n", jobs[i].name, jobs[i].pid);
+    }
+    fflush(stdout);
+    last_status = 0;
+}
+
+// Ends all coprocesses when the shell exits: EOF on their stdin, SIGTERM, and then they are reaped
+void close_jobs() {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (jobs[i].pid <= 0) continue;
+        pid_t pid = jobs[i].pid;
+        remove_job(&jobs[i]);
+        killpg(pid, SIGTERM); // > the whole group, a coprocess like `coproc P a | b` is a sub-shell with children
+        killpg(pid, SIGCONT); // > a stopped process would not handle SIGTERM
+        while (waitpid(pid, NULL, 0) == -1 && errno == EINTR);
+    }
+}
+
+/*
+ * Looks for the fd redirections <&X and >&X within the arguments. X is the name of a coprocess
+ * (<&NAME reads its stdout, >&NAME writes to its stdin) or an fd number (e.g. >&2).
+ * The redirection tokens are removed from args. *in_fd / *out_fd get a new fd (FD_CLOEXEC),
+ * an older fd in *in_fd (e.g. from a here-document) is replaced. Returns 0 on success, -1 on error.
+ */
+int extract_fd_redirections(char **args, int *in_fd, int *out_fd) {
+    for (int i = 0; args[i]; ) {
+        if ((args[i][0] != '<' && args[i][0] != '>') || args[i][1] != '&' || args[i][2] == '\0') {
+            i++;
+            continue;
+        }
+
+        const char *target = args[i] + 2;
+        int source_fd = -1;
+        struct job *job = find_job(target);
+        if (job) {
+            source_fd = (args[i][0] == '<') ? job->from_fd : job->to_fd;
+        } else if (target[0] >= '0' && target[0] <= '9') {
+            source_fd = atoi(target);
+        }
+
+        int fd = (source_fd >= 0) ? fcntl(source_fd, F_DUPFD_CLOEXEC, 3) : -1;
+        if (fd == -1) {
+            fprintf(stderr, "Error: Bad redirection target '%s'.\n", target);
+            return -1;
+        }
+
+        int *slot = (args[i][0] == '<') ? in_fd : out_fd;
+        if (*slot >= 0) close(*slot);
+        *slot = fd;
+
+        // Remove the redirection token from args (including the terminating NULL)
+        int j = i;
+        do {
+            args[j] = args[j + 1];
+        } while (args[j++]);
+    }
+    return 0;
+}
+
+/*
+ * Handles the pipe between two or more programs
+ * The pipe() system call creates a unidirectional communication channel.
+ * For N piped commands, N-1 pipes are needed to transfer data from one command to the next.
+ * Each pipe consists of a read and write end (pipefd[0] and pipefd[1]).
+ * We use dup2() to redirect stdin and stdout to the appropriate pipe ends.
+ * A single command without '|' is handled here as well, it is a pipeline with one command.
+ * With a timeout in opts all commands are put into one process group, so that the group can be killed at once.
+ */
+void handle_multi_pipe(char *input, struct exec_options *opts) {
+    // Fan-out: producer |+ consumer... is run as the rewritten pipeline with tee
+    char *fanout;
+    int fanout_result = expand_fanout(input, &fanout);
+    if (fanout_result != 0) {
+        if (fanout_result > 0) {
+            handle_multi_pipe(fanout, opts);
+            free(fanout);
+        } else {
+            last_status = 2;
+        }
+        return;
+    }
+
+    // Split by '|'
+    char *commands[MAX_ARGS];
+    int count = 0;
+    char *saveptr;
+
+    char *token = split_top_level(input, '|', &saveptr); // > a '|' inside a process substitution does not split the pipeline
+    while (token && count < MAX_ARGS) {
+        while (*token == ' ') token++; // skip leading spaces
+        if (*token == '\0') {
+            fprintf(stderr, "Error: Empty command between pipes not allowed.\n");
+            return;
+        }
+        commands[count++] = token;
+        token = split_top_level(NULL, '|', &saveptr);
+    }
+
+    if (count == 0) {
+        fprintf(stderr, "Error: No valid command detected.\n");
+        return;
+    }
+
+    // If original input starts or ends with '|', reject
+    size_t len = strlen(input);
+    if (input[0] == '|' || input[len - 1] == '|') {
+        // > after I learn in the Uebung 6, I think it is better if I just set an error commands for the right one too.
+        fprintf(stderr, "Error: Pipe at beginning or end not allowed.\n");
+        return;
+    }
+
+    int **pipes = malloc((count - 1) * sizeof(int *));
+    for (int i = 0; i < count - 1; ++i) {
+        pipes[i] = malloc(2 * sizeof(int));
+        if (pipe(pipes[i]) == -1) {
+            perror("pipe failed");
+            return;
+        }
+    }
+
+    // Output capture: the pipes are created before the first fork, so that every command gets the write ends
+    struct output_capture *capture = opts ? opts->capture : NULL;
+    int capture_pipes[2][2] = { { -1, -1 }, { -1, -1 } };
+    if (capture) {
+        for (int stream = 0; stream < 2; stream++) {
+            if (pipe_cloexec(capture_pipes[stream]) == -1) { // > commands only get them with dup2(), not by inheriting
+                perror("pipe failed");
+                capture = NULL;
+                break;
+            }
+        }
+        if (!capture) {
+            for (int stream = 0; stream < 2; stream++) {
+                if (capture_pipes[stream][0] >= 0) close(capture_pipes[stream][0]);
+                if (capture_pipes[stream][1] >= 0) close(capture_pipes[stream][1]);
+            }
+        }
+    }
+
+    pid_t pids[MAX_ARGS];
+    struct procsub_list subs[MAX_ARGS];
+    int own_group = (opts && opts->timeout > 0); // > the timeout is applied to the process group of the whole pipeline
+    int take_terminal = own_group && shell_owns_terminal();
+    pid_t pgid = 0;
+    for (int i = 0; i < count; ++i) {
+        char *cmd_copy = strdup(commands[i]); // > copy the value of the commands into cmd_copy, so that it does not corrupt the data!
+        char **args = parse_input(cmd_copy); // > take the command and convert them into string array, so that it could be executed with the given parameter through execv().
+        int sub_error = expand_process_substitutions(args, &subs[i], own_group ? &pgid : NULL); // > a timeout also ends them
+        int in_fd = sub_error ? -2 : extract_heredoc(args); // > a here-document replaces the input that would come from the previous pipe
+        int out_fd = -1;
+        if (in_fd != -2 && extract_fd_redirections(args, &in_fd, &out_fd) != 0) { // > <&NAME / >&NAME of a coprocess
+            if (in_fd >= 0) close(in_fd);
+            in_fd = -2;
+        }
+
+        if (in_fd != -2 && args[0] && !find_builtin(args[0])) resolve_command(args[0]); // > once in the shell, not in every child
+        sync_input(); // > the first command may read stdin of the shell
+        pid_t pid = fork();
+        if (pid == 0) {
+            close_sigchld_pipe();
+            if (own_group) {
+                setpgid(0, pgid); // > pgid 0 for the first command: it becomes the leader of a new group
+                if (take_terminal) set_terminal_owner(getpgrp()); // > otherwise reading the terminal would stop the command
+            }
+
+            if (opts && apply_limits(opts) != 0) exit(1); // > never run the command without the limits it was given
+
+            // > how the dup works https://youtu.be/PIb2aShU_H4?si=WET26X4zSAwlRPhu$0
+            if (in_fd == -2 || !args[0]) exit(1); // > the error message is already printed by extract_heredoc()
+            if (in_fd >= 0) { // Here-document or here-string: read from it instead of the previous pipe
+                dup2(in_fd, STDIN_FILENO);
+            } else if (i > 0) { // Not first: read from previous pipe
+                dup2(pipes[i - 1][0], STDIN_FILENO);
+            }
+            if (out_fd >= 0) { // >&NAME or >&N: write there instead of the next pipe
+                dup2(out_fd, STDOUT_FILENO);
+            } else if (i < count - 1) { // Not last: write to next pipe
+                dup2(pipes[i][1], STDOUT_FILENO); // > take the Process content of the index pipefd[1] and into the index of STDOUT located, so that the stdout (output) values will be redirected into the pipe.
+            } else if (capture) { // Last with capture: the shell reads the output
+                dup2(capture_pipes[0][1], STDOUT_FILENO);
+            }
+            if (capture) dup2(capture_pipes[1][1], STDERR_FILENO); // > stderr of every command is captured
+
+            // Close all pipes in child, because dup2()-functionality: duplicates the file descriptors (see Ueubng 6)
+            for (int j = 0; j < count - 1; ++j) {
+                close(pipes[j][0]);
+                close(pipes[j][1]);
+            }
+
+            // A built-in within a pipeline runs in this child, e.g. `jobs | wc -l`
+            struct builtin *builtin = find_builtin(args[0]);
+            if (builtin) {
+                // > no exec resets the handlers of the shell, without this Ctrl+C would not end e.g. `cat | wc`
+                signal(SIGINT, SIG_DFL);
+                signal(SIGHUP, SIG_DFL);
+                int argc = 0;
+                while (args[argc]) argc++;
+                int fds[3] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+                int builtin_status = builtin->handler(argc, args, fds);
+                fflush(stdout);
+                exit(builtin_status);
+            }
+
+            exec_command(args); // > execvp means execute program with vector (array) as input and uses path to look for the program
+        } else if (pid > 0) {
+            // Parent process: increment child counter
+            child_count++;
+            if (own_group) {
+                if (pgid == 0) pgid = pid;
+                setpgid(pid, pgid); // > also done in the parent, so that killpg() works even if the child has not run yet
+                if (take_terminal && i == 0) set_terminal_owner(pgid);
+            }
+        } else {
+            perror("fork failed");
+        }
+        pids[i] = pid;
+
+        if (in_fd >= 0) close(in_fd); // > the child has its own copy now
+        if (out_fd >= 0) close(out_fd);
+        close_process_substitutions(&subs[i]); // > only the command may hold the /dev/fd/N ends, otherwise it never gets EOF
+        free(cmd_copy);
+        free(args);
+    }
+
+    // Close all pipes in parent
+    for (int i = 0; i < count - 1; ++i) {
+        close(pipes[i][0]);
+        close(pipes[i][1]);
+        free(pipes[i]);
+    }
+    free(pipes);
+
+    if (capture) {
+        // > the shell keeps only the read ends, the pipes get EOF when the last command has closed its write ends
+        for (int stream = 0; stream < 2; stream++) {
+            close(capture_pipes[stream][1]);
+            capture->fds[stream] = capture_pipes[stream][0];
+        }
+    }
+
+    // Wait for all children, the return value of the pipeline is the one of the last command
+    last_status = wait_for_pipeline(pids, count, pgid, opts);
+    if (take_terminal) set_terminal_owner(getpgrp()); // > the shell reads the next command from the terminal again
+    for (int i = 0; i < count; ++i) {
+        reap_process_substitutions(&subs[i]);
+    }
+}
+
+// Sink of the output capture with `capture on`: writes the output into the ring of the running command
+void record_sink(struct output_capture *capture, int stream, const char *data, size_t len) {
+    struct captured_command *slot = capture->context;
+    (void)stream; // > stdout and stderr are kept together, like they were shown on the terminal
+    if (len > CAPTURE_MAX_BYTES) { // > only the end of a huge block fits into the ring
+        slot->total += len - CAPTURE_MAX_BYTES;
+        data += len - CAPTURE_MAX_BYTES;
+        len = CAPTURE_MAX_BYTES;
+    }
+    while (len > 0) {
+        size_t offset = slot->total % CAPTURE_MAX_BYTES;
+        size_t part = CAPTURE_MAX_BYTES - offset < len ? CAPTURE_MAX_BYTES - offset : len; // > up to the end of the ring
+        ssize_t written = pwrite(slot->fd, data, part, offset);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return; // > e.g. out of memory, the terminal still got the output
+        slot->total += written;
+        data += written;
+        len -= written;
+    }
+}
+
+/*
+ * Prepares the free slot of captures[] for command_line. Returns NULL if nothing is recorded: capture is off, the
+ * memfd cannot be created or the line starts with `last`.
+ */
+struct captured_command *begin_capture(const char *command_line) {
+    // > `last | grep x` is not recorded, otherwise the output it shows would become `last 1` itself
+    size_t blanks = strspn(command_line, " \t");
+    int is_last = strncmp(command_line + blanks, "last", 4) == 0 && strchr(" \t|", command_line[blanks + 4]); // > also '\0'
+    if (!capture_enabled || is_last) return NULL;
+
+    struct captured_command *slot = &captures[(capture_newest + 1) % (MAX_CAPTURES + 1)];
+    if (slot->fd < 0) slot->fd = memory_fd("minishell-last");
+    if (slot->fd < 0) return NULL;
+    int truncated = ftruncate(slot->fd, 0); // > frees the memory of an older large output, the ring works without it too
+    (void)truncated;
+    slot->total = 0;
+    free(slot->command);
+    slot->command = strdup(command_line); // > before handle_multi_pipe(), it splits the line in place
+    return slot;
+}
+
+// Makes the slot of begin_capture() the newest one for `last`, with last_status and the time of its command
+void end_capture(struct captured_command *slot, double seconds) {
+    slot->seconds = seconds;
+    slot->status = last_status;
+    capture_newest = slot - captures;
+    if (capture_count < MAX_CAPTURES) capture_count++;
+}
+
+/*
+ * Runs a command line in the foreground like handle_multi_pipe(). With `capture on` its output also goes into
+ * the free slot of captures[], which becomes the newest one for `last` when the command has ended.
+ * A command line that starts with `last` is not recorded.
+ */
+void run_foreground(char *command_line, struct exec_options *opts) {
+    struct captured_command *slot = begin_capture(command_line);
+    if (!slot) {
+        handle_multi_pipe(command_line, opts);
+        return;
+    }
+
+    struct exec_options no_options = { 0 };
+    if (!opts) opts = &no_options;
+    struct output_capture capture = { .fds = { -1, -1 }, .sink = record_sink, .context = slot, .next = opts->capture };
+    opts->capture = &capture;
+    fflush(stdout);
+    double start = monotonic_now();
+    handle_multi_pipe(command_line, opts);
+    opts->capture = capture.next;
+    end_capture(slot, monotonic_now() - start);
+}
+
+/*
+ * Parses a time like `timeout(1)` does: a number (also with a fraction like 0.5)
+ * and an optional unit s (seconds, default), m (minutes), h (hours) or d (days).
+ * Returns 0 on success, -1 if the text is not a valid duration.
+ */
+int parse_duration(const char *text, double *seconds) {
+    char *end;
+    errno = 0;
+    double value = strtod(text, &end);
+    if (end == text || errno != 0 || value < 0) return -1;
+
+    if (*end == '\0' || strcmp(end, "s") == 0) *seconds = value;
+    else if (strcmp(end, "m") == 0) *seconds = value * 60;
+    else if (strcmp(end, "h") == 0) *seconds = value * 3600;
+    else if (strcmp(end, "d") == 0) *seconds = value * 86400;
+    else return -1;
+    return 0;
+}
+
+/*
+ * Parses the built-in `timeout [-k KILLAFTER] DURATION cmd...` into opts.
+ * Returns the index of the command in args, or -1 (with an error message) if the arguments are invalid.
+ */
+int parse_timeout(char **args, struct exec_options *opts) {
+    int i = 1;
+    opts->kill_after = 0;
+    if (args[i] && strcmp(args[i], "-k") == 0) {
+        if (!args[i + 1] || parse_duration(args[i + 1], &opts->kill_after) != 0) {
+            fprintf(stderr, "timeout: invalid kill time\n");
+            return -1;
+        }
+        i += 2;
+    }
+    if (!args[i] || parse_duration(args[i], &opts->timeout) != 0) {
+        fprintf(stderr, "Usage: timeout [-k KILLAFTER] DURATION cmd...\n");
+        return -1;
+    }
+    if (!args[i + 1]) {
+        fprintf(stderr, "Usage: timeout [-k KILLAFTER] DURATION cmd...\n");
+        return -1;
+    }
+    return i + 1;
+}
+
+/*
+ * Parses the built-in `limit [-c|-f|-n|-t|-u|-v VALUE]... [--] cmd...` into opts.
+ * The limits are only set for the children of cmd (see apply_limits()), not for the shell.
+ * Returns the index of the command in args, or -1 (with an error message) if the arguments are invalid.
+ */
+int parse_limit(char **args, struct exec_options *opts) {
+    int i = 1;
+    while (args[i] && args[i][0] == '-') {
+        if (strcmp(args[i], "--") == 0) {
+            i++;
+            break;
+        }
+        struct limit_option *option = (args[i][1] != '\0' && args[i][2] == '\0') ? find_limit_option(args[i][1]) : NULL; // > "-" alone has no [2]
+        if (!option) {
+            fprintf(stderr, "limit: unknown option '%s'\n", args[i]);
+            return -1;
+        }
+        rlim_t value;
+        if (!args[i + 1] || parse_limit_value(args[i + 1], option, &value) != 0) {
+            fprintf(stderr, "limit: invalid value for '%s'\n", args[i]);
+            return -1;
+        }
+
+        // > the same option twice replaces the first value
+        int k = 0;
+        while (k < opts->limit_count && opts->limit_resources[k] != option->resource) k++;
+        opts->limit_resources[k] = option->resource;
+        opts->limit_values[k] = value;
+        if (k == opts->limit_count) opts->limit_count++;
+        i += 2;
+    }
+    if (!args[i]) {
+        fprintf(stderr, "Usage: limit [-c|-f|-n|-t|-u|-v VALUE]... [--] cmd...\n");
+        return -1;
+    }
+    return i;
+}
+
+/*
+ * Parses the prefix built-ins `timeout` and `limit` at the start of a command, they can be combined
+ * (e.g. `limit -v 100000 timeout 5 cmd`). Returns the index of the command after the prefixes
+ * (0 if there is no prefix), or -1 if the arguments are invalid (last_status is set then).
+ */
+int parse_exec_prefixes(char **args, struct exec_options *opts) {
+    int i = 0;
+    while (args[i]) {
+        int next;
+        if (strcmp(args[i], "timeout") == 0) {
+            next = parse_timeout(args + i, opts);
+            if (next < 0) {
+                last_status = 125; // > same as timeout(1) for invalid arguments
+                return -1;
+            }
+        } else if (strcmp(args[i], "limit") == 0) {
+            next = parse_limit(args + i, opts);
+            if (next < 0) {
+                last_status = 2;
+                return -1;
+            }
+        } else {
+            break;
+        }
+        i += next;
+    }
+    return i;
+}
+
+// Prints one line of `ulimit -a` or the value for a single option
+void print_limit(struct limit_option *option, int hard, int with_description) {
+    struct rlimit rl;
+    if (getrlimit(option->resource, &rl) != 0) {
+        perror("ulimit: getrlimit failed");
+        return;
+    }
+    rlim_t value = hard ? rl.rlim_max : rl.rlim_cur;
+    if (with_description) printf("%-30s (-%c) ", option->description, option->flag);
+    if (value == RLIM_INFINITY) printf("unlimited\n");
+    else printf("%llu\n", (unsigned long long)(value / option->unit));
+}
+
+/*
+ * Handles the built-in `ulimit [-S|-H] [-a | -c|-f|-n|-t|-u|-v [VALUE]]`.
+ * The limit is set for the shell itself, so every command started afterwards inherits it.
+ * Without -H only the soft limit is changed, so it can be raised again later (up to the hard limit).
+ */
+void handle_ulimit(char **args) {
+    int hard = 0;
+    int show_all = 0;
+    struct limit_option *option = NULL;
+    const char *value_text = NULL;
+
+    for (int i = 1; args[i]; i++) {
+        if (strcmp(args[i], "-H") == 0) hard = 1;
+        else if (strcmp(args[i], "-S") == 0) hard = 0;
+        else if (strcmp(args[i], "-a") == 0) show_all = 1;
+        else if (args[i][0] == '-' && args[i][1] != '\0' && args[i][2] == '\0' && find_limit_option(args[i][1])) option = find_limit_option(args[i][1]);
+        else if (!value_text) value_text = args[i];
+        else {
+            fprintf(stderr, "Usage: ulimit [-S|-H] [-a | -c|-f|-n|-t|-u|-v [VALUE]]\n");
+            last_status = 2;
+            return;
+        }
+    }
+
+    last_status = 0;
+    if (show_all || (!option && !value_text)) {
+        for (int i = 0; i < LIMIT_COUNT; i++) print_limit(&limit_options[i], hard, 1);
+        fflush(stdout);
+        return;
+    }
+    if (!option) option = find_limit_option('f'); // > like in bash and POSIX sh, a value alone is the file size
+    if (!value_text) {
+        print_limit(option, hard, 0);
+        fflush(stdout);
+        return;
+    }
+
+    struct rlimit rl;
+    rlim_t value;
+    if (parse_limit_value(value_text, option, &value) != 0 || getrlimit(option->resource, &rl) != 0) {
+        fprintf(stderr, "ulimit: invalid value '%s'\n", value_text);
+        last_status = 1;
+        return;
+    }
+    if (hard) {
+        rl.rlim_max = value;
+        if (rl.rlim_cur == RLIM_INFINITY || (value != RLIM_INFINITY && rl.rlim_cur > value)) rl.rlim_cur = value;
+    } else {
+        rl.rlim_cur = value;
+    }
+    if (setrlimit(option->resource, &rl) != 0) {
+        fprintf(stderr, "ulimit: %s\n", strerror(errno));
+        last_status = 1;
+    }
+}
+
+// 64-bit FNV-1a hash, hash is the result of the previous call (or the offset basis for the first one)
+uint64_t fnv1a(uint64_t hash, const void *data, size_t len) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL; // > FNV prime for 64 bit
+    }
+    return hash;
+}
+
+/*
+ * Directory of the `cache` store: $MINISHELL_CACHE_DIR, otherwise $XDG_CACHE_HOME/minishell or ~/.cache/minishell.
+ * Returns -1 if neither the variables nor HOME are set or the path is too long.
+ */
+int cache_directory(char *path, size_t size) {
+    const char *dir = getenv("MINISHELL_CACHE_DIR");
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    int len;
+    if (dir && *dir) len = snprintf(path, size, "%s", dir);
+    else if (xdg && *xdg) len = snprintf(path, size, "%s/minishell", xdg);
+    else if (home && *home) len = snprintf(path, size, "%s/.cache/minishell", home);
+    else return -1;
+    return (size_t)len < size ? 0 : -1; // > a truncated path would be a different directory
+}
+
+// Creates path and all missing parent directories, like mkdir -p
+int make_directories(const char *path) {
+    char partial[PATH_MAX];
+    snprintf(partial, sizeof(partial), "%s", path);
+    for (char *p = partial + 1; ; p++) {
+        if (*p != '/' && *p != '\0') continue;
+        char end = *p;
+        *p = '\0';
+        if (mkdir(partial, 0700) != 0 && errno != EEXIST) return -1;
+        *p = end;
+        if (end == '\0') return 0;
+    }
+}
+
+/*
+ * Key of a `cache` entry. Hashed are: the words of the command, the bodies of its here-documents, the working
+ * directory, the given environment variables (PATH always, it decides which program runs) and for every input file
+ * its device, inode, size and mtime.
+ * The content of the inputs is not read, like make the shell trusts that a changed file has a new mtime or size.
+ */
+uint64_t cache_key(char **command_args, const struct heredoc_body *bodies, char **env_names, int env_count, char **inputs, int input_count) {
+    uint64_t hash = fnv1a(14695981039346656037ULL, "minishell-cache-1", 18); // > FNV offset basis, the version changes the keys if the format changes
+
+    for (int i = 0; command_args[i]; i++) {
+        hash = fnv1a(hash, command_args[i], strlen(command_args[i]) + 1); // > with the '\0', so that "a b" and "ab" differ
+    }
+    for (; bodies; bodies = bodies->next) {
+        uint64_t len = bodies->len; // > the length first, so that the border between two bodies is part of the key
+        hash = fnv1a(hash, &len, sizeof(len));
+        hash = fnv1a(hash, bodies->data, bodies->len);
+    }
+
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd))) hash = fnv1a(hash, cwd, strlen(cwd) + 1);
+
+    hash = fnv1a(hash, "PATH=", 5);
+    const char *path = getenv("PATH");
+    if (path) hash = fnv1a(hash, path, strlen(path) + 1);
+    for (int i = 0; i < env_count; i++) {
+        const char *value = getenv(env_names[i]);
+        hash = fnv1a(hash, env_names[i], strlen(env_names[i]));
+        hash = fnv1a(hash, value ? "=" : "!", 1); // > an unset variable differs from an empty one
+        if (value) hash = fnv1a(hash, value, strlen(value) + 1);
+    }
+
+    for (int i = 0; i < input_count; i++) {
+        struct stat st;
+        hash = fnv1a(hash, inputs[i], strlen(inputs[i]) + 1);
+        if (stat(inputs[i], &st) != 0) {
+            hash = fnv1a(hash, "missing", 7);
+            continue;
+        }
+        uint64_t fingerprint[5] = {
+            (uint64_t)st.st_dev, (uint64_t)st.st_ino, (uint64_t)st.st_size,
+            (uint64_t)st.st_mtim.tv_sec, (uint64_t)st.st_mtim.tv_nsec,
+        };
+        hash = fnv1a(hash, fingerprint, sizeof(fingerprint));
+    }
+    return hash;
+}
+
+/*
+ * Copies the file path to stream (0 = stdout, 1 = stderr) of the shell and hands every block to the sinks of capture
+ * (NULL for none), like pump_capture() does for a running command. Returns -1 if the file cannot be opened.
+ */
+int replay_file(const char *path, int stream, struct output_capture *capture) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    int out_fd = stream == 0 ? STDOUT_FILENO : STDERR_FILENO;
+    char buffer[INPUT_BLOCK];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+        for (struct output_capture *c = capture; c; c = c->next) {
+            if (c->sink) c->sink(c, stream, buffer, (size_t)n);
+        }
+        for (ssize_t done = 0; done < n; ) {
+            ssize_t written = write(out_fd, buffer + done, n - done);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) {
+                close(fd);
+                return 0; // > the reader is gone (e.g. closed pipe), nothing more to replay
+            }
+            done += written;
+        }
+    }
+    close(fd);
+    return 0;
+}
+
+// Files of a `cache` entry that is written right now
+struct cache_store {
+    int fds[2];  // > stdout and stderr file in the temporary directory
+    int failed;  // > a write failed (e.g. disk full), the entry is not stored
+};
+
+// Sink of the output capture: appends the output of the command to the stdout / stderr file of the entry
+void cache_sink(struct output_capture *capture, int stream, const char *data, size_t len) {
+    struct cache_store *store = capture->context;
+    for (size_t done = 0; done < len && !store->failed; ) {
+        ssize_t written = write(store->fds[stream], data + done, len - done);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) store->failed = 1;
+        else done += written;
+    }
+}
+
+// Removes a (temporary) entry directory with its three files
+void remove_cache_entry(const char *entry) {
+    const char *files[] = { "stdout", "stderr", "status" };
+    char path[PATH_MAX + 96];
+    for (int i = 0; i < 3; i++) {
+        snprintf(path, sizeof(path), "%s/%s", entry, files[i]);
+        unlink(path);
+    }
+    rmdir(entry);
+}
+
+/*
+ * Built-in: cache [--inputs FILE...] [--env NAME]... -- cmd...
+ * Memoizes the output of a deterministic command (also a pipeline). An entry is the directory <store>/<key> with the
+ * files stdout, stderr and status, the key is cache_key() in hex.
+ * Hit: stdout, stderr and the exit status are replayed, the command does not run. Here-documents are read first in
+ * both cases, their bodies are part of the key.
+ * Miss: the command runs in the normal way (with timeout / limit of opts) and its output is captured. The shell
+ * passes it on and writes a copy into a temporary directory, which is renamed to <key> at the end. rename() is
+ * atomic, so a second shell sees either no entry or a complete one. Runs that were killed by a signal or a timeout
+ * are not stored.
+ * args[0] is "cache", command is the whole segment and command_copy the copy args points into.
+ */
+void handle_cache(char **args, char *command, char *command_copy, struct exec_options *opts) {
+    char **inputs = NULL;
+    int input_count = 0;
+    char *env_names[MAX_CACHE_ENV];
+    int env_count = 0;
+    int cmd_index = 0;
+
+    for (int i = 1; args[i]; i++) {
+        if (strcmp(args[i], "--") == 0) {
+            cmd_index = i + 1;
+            break;
+        }
+        if (strcmp(args[i], "--inputs") == 0) {
+            inputs = &args[i + 1];
+            while (args[i + 1] && strncmp(args[i + 1], "--", 2) != 0) { // > all words up to the next option are inputs
+                input_count++;
+                i++;
+            }
+        } else if (strcmp(args[i], "--env") == 0 && args[i + 1] && env_count < MAX_CACHE_ENV) {
+            env_names[env_count++] = args[++i];
+        } else if (args[i][0] == '-') {
+            cmd_index = 0;
+            break;
+        } else {
+            cmd_index = i; // > without options the -- can be left out
+            break;
+        }
+    }
+    if (cmd_index == 0 || !args[cmd_index]) {
+        fprintf(stderr, "Usage: cache [--inputs FILE...] [--env NAME]... -- cmd...\n");
+        last_status = 2;
+        return;
+    }
+    char *rest = command + (args[cmd_index] - command_copy); // > args point into command_copy, at the same offset as in command
+
+    // > the bodies of here-documents are read now: they are part of the key, and on a hit they must not stay on stdin
+    if (prefetch_heredocs(args + cmd_index) != 0) {
+        drop_prefetched_heredocs();
+        last_status = 1;
+        return;
+    }
+
+    char dir[PATH_MAX];
+    if (cache_directory(dir, sizeof(dir)) != 0 || make_directories(dir) != 0) {
+        fprintf(stderr, "cache: cannot use the cache directory, running without cache\n");
+        run_foreground(rest, opts);
+        drop_prefetched_heredocs();
+        return;
+    }
+
+    uint64_t key = cache_key(args + cmd_index, prefetched_bodies, env_names, env_count, inputs, input_count);
+    char entry[PATH_MAX + 32]; // > each path is a bit longer than the one it is built from, so it is never truncated
+    char path[PATH_MAX + 96];
+    snprintf(entry, sizeof(entry), "%s/%016llx", dir, (unsigned long long)key);
+
+    // Hit: the status file exists only in a complete entry
+    snprintf(path, sizeof(path), "%s/status", entry);
+    FILE *status_file = fopen(path, "r");
+    if (status_file) {
+        int status;
+        int valid = fscanf(status_file, "%d", &status) == 1;
+        fclose(status_file);
+        if (valid) {
+            if(DEBUG) printf("[DEBUG] cache hit %016llx\n", (unsigned long long)key);
+            fflush(stdout);
+            struct captured_command *slot = begin_capture(rest); // > with `capture on` a hit is recorded like a run
+            struct output_capture capture = { .fds = { -1, -1 }, .sink = record_sink, .context = slot };
+            double start = monotonic_now();
+            snprintf(path, sizeof(path), "%s/stdout", entry);
+            replay_file(path, 0, slot ? &capture : NULL);
+            snprintf(path, sizeof(path), "%s/stderr", entry);
+            replay_file(path, 1, slot ? &capture : NULL);
+            drop_prefetched_heredocs();
+            last_status = status;
+            if (slot) end_capture(slot, monotonic_now() - start);
+            return;
+        }
+    }
+
+    // Miss: run the command and store its output in a temporary entry
+    char temp[PATH_MAX + 64];
+    snprintf(temp, sizeof(temp), "%s.tmp.%d", entry, (int)getpid());
+    struct cache_store store = { .fds = { -1, -1 }, .failed = 0 };
+    if (mkdir(temp, 0700) == 0) {
+        snprintf(path, sizeof(path), "%s/stdout", temp);
+        store.fds[0] = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        snprintf(path, sizeof(path), "%s/stderr", temp);
+        store.fds[1] = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    }
+    if (store.fds[0] < 0 || store.fds[1] < 0) {
+        fprintf(stderr, "cache: cannot create entry in %s, running without cache\n", dir);
+        if (store.fds[0] >= 0) close(store.fds[0]);
+        if (store.fds[1] >= 0) close(store.fds[1]);
+        remove_cache_entry(temp);
+        run_foreground(rest, opts);
+        drop_prefetched_heredocs();
+        return;
+    }
+
+    struct output_capture capture = { .fds = { -1, -1 }, .sink = cache_sink, .context = &store };
+    fflush(stdout);
+    opts->capture = &capture;
+    run_foreground(rest, opts);
+    opts->capture = NULL;
+    drop_prefetched_heredocs(); // > a command that failed before its here-document leaves the body unused
+    close(store.fds[0]);
+    close(store.fds[1]);
+
+    int killed = last_status < 0 || (opts->timeout > 0 && (last_status == 124 || last_status == 128 + SIGKILL));
+    snprintf(path, sizeof(path), "%s/status", temp);
+    status_file = (killed || store.failed) ? NULL : fopen(path, "w");
+    if (status_file) {
+        fprintf(status_file, "%d\n", last_status);
+        store.failed = fclose(status_file) != 0;
+    }
+    if (!status_file || store.failed || rename(temp, entry) != 0) {
+        remove_cache_entry(temp); // > not stored, or another shell has stored the same entry in the meantime
+    }
+}
+
+// Handles the 'cd' command to change directories
+void handle_cd(char **args)
+{
+    const char *target = args[1] ? args[1] : getenv("HOME");
+    char path[PATH_MAX];
+
+    if (args[1] && args[1][0] == '~')
+    {
+        const char *home = getenv("HOME");
+        snprintf(path, sizeof(path), "%s%s", home, args[1] + 1); // > if the first character of args[1] is '~', then we take the home directory and concatenate it with the rest of the path.
+        target = path;
+    }
+
+    if (chdir(target) != 0) // > chdir: change directory to the given path
+    {
+        fprintf(stderr, "cd failed: %s\n", strerror(errno)); // > send a message why it does not work.
+        last_status = 1;
+    }
+    else
+    {
+        last_status = 0;
+    }
+}
+
+// Native built-ins, with the signature of minishell_builtin.h
+int builtin_exit(int argc, char **argv, int fds[3]) {
+    (void)argc; (void)argv; (void)fds;
+    exit_requested = 1;
+    return 0;
+}
+
+int builtin_cd(int argc, char **argv, int fds[3]) {
+    (void)argc; (void)fds;
+    handle_cd(argv);
+    return last_status;
+}
+
+int builtin_ret(int argc, char **argv, int fds[3]) {
+    (void)argc; (void)argv; (void)fds;
+    handle_sighup(0);
+    return last_status; // > ret does not change the return value it displays
+}
+
+int builtin_jobs(int argc, char **argv, int fds[3]) {
+    (void)argc; (void)argv; (void)fds;
+    handle_jobs();
+    return last_status;
+}
+
+int builtin_ulimit(int argc, char **argv, int fds[3]) {
+    (void)argc; (void)fds;
+    handle_ulimit(argv);
+    return last_status;
+}
+
+// Returns 1 if fd is a pipe (or FIFO), splice() and tee() need a pipe on one / both sides
+int is_pipe(int fd) {
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+// Writes all len bytes of data to fd, returns -1 on error
+int write_all(int fd, const char *data, size_t len) {
+    for (size_t done = 0; done < len; ) {
+        ssize_t written = write(fd, data + done, len - done);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return -1;
+        done += written;
+    }
+    return 0;
+}
+
+#ifdef __linux__
+// Moves exactly len bytes from in_fd to out_fd with splice(), one of them must be a pipe
+int splice_all(int in_fd, int out_fd, size_t len) {
+    while (len > 0) {
+        ssize_t moved = splice(in_fd, NULL, out_fd, NULL, len, SPLICE_F_MOVE);
+        if (moved < 0 && errno == EINTR) continue;
+        if (moved <= 0) return -1;
+        len -= moved;
+    }
+    return 0;
+}
+#endif
+
+/*
+ * Copies in_fd to out_fd until EOF, used by the built-in cat.
+ * If one side is a pipe the data is moved with splice(), from a regular file with sendfile(), in both cases
+ * the kernel moves the pages and nothing is copied through user space. If the kernel refuses the first call
+ * (e.g. a terminal or a file opened with O_APPEND) it falls back to read() and write(), on macOS always.
+ * Returns 0 on success, -1 on error.
+ */
+int copy_fd(int in_fd, int out_fd) {
+#ifdef __linux__
+    struct stat st;
+    int use_splice = is_pipe(in_fd) || is_pipe(out_fd);
+    int use_sendfile = !use_splice && fstat(in_fd, &st) == 0 && S_ISREG(st.st_mode);
+    int first = 1;
+
+    while (use_splice || use_sendfile) {
+        ssize_t moved = use_splice ? splice(in_fd, NULL, out_fd, NULL, SPLICE_BLOCK, SPLICE_F_MOVE | SPLICE_F_MORE)
+                                   : sendfile(out_fd, in_fd, NULL, SPLICE_BLOCK);
+        if (moved == 0) return 0;
+        if (moved > 0) {
+            first = 0;
+            continue;
+        }
+        if (errno == EINTR) continue;
+        if (first && (errno == EINVAL || errno == ENOSYS)) break; // > not supported for these fds, nothing moved yet
+        return -1;
+    }
+#endif
+
+    char buffer[SPLICE_BLOCK];
+    ssize_t n;
+    while ((n = read(in_fd, buffer, sizeof(buffer))) != 0) {
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 || write_all(out_fd, buffer, n) != 0) return -1;
+    }
+    return 0;
+}
+
+/*
+ * Copies in_fd to all count fds in out_fds until EOF, used by the built-in tee.
+ * Zero-copy when in_fd is a pipe and every output is a pipe or a regular file: per block tee(2) duplicates the
+ * pages of in_fd into an empty helper pipe for every output except the last one, without consuming them. Then
+ * splice() moves the block from in_fd to the last output (this consumes it) and from the helper pipes to the others.
+ * Otherwise (and on macOS) every block is read once and written to each output.
+ * Returns 0 on success, -1 on error.
+ */
+int tee_fds(int in_fd, int *out_fds, int count) {
+#ifdef __linux__
+    int zero_copy = is_pipe(in_fd);
+#else
+    int zero_copy = 0; // > tee() and splice() exist only on Linux
+#endif
+    for (int i = 0; i < count && zero_copy; i++) {
+        struct stat st;
+        int flags = fcntl(out_fds[i], F_GETFL);
+        zero_copy = fstat(out_fds[i], &st) == 0 && (S_ISFIFO(st.st_mode) || S_ISREG(st.st_mode))
+                    && flags != -1 && !(flags & O_APPEND); // > splice() does not write to a file with O_APPEND
+    }
+
+    int (*helpers)[2] = NULL;
+    int helper_count = 0;
+    if (zero_copy && count > 1) {
+        helpers = malloc((count - 1) * sizeof(*helpers));
+        for (; helpers && helper_count < count - 1; helper_count++) {
+            if (pipe_cloexec(helpers[helper_count]) == -1) break;
+        }
+        if (!helpers || helper_count < count - 1) zero_copy = 0;
+    }
+
+    int result = 0;
+    if (zero_copy) {
+#ifdef __linux__
+        while (1) {
+            ssize_t block;
+            if (count > 1) {
+                block = tee(in_fd, helpers[0][1], SPLICE_BLOCK, 0); // > blocks until data is there, 0 = EOF
+            } else {
+                block = splice(in_fd, NULL, out_fds[0], NULL, SPLICE_BLOCK, SPLICE_F_MOVE | SPLICE_F_MORE);
+            }
+            if (block < 0 && errno == EINTR) continue;
+            if (block <= 0) {
+                result = block == 0 ? 0 : -1;
+                break;
+            }
+            if (count == 1) continue;
+
+            for (int i = 1; i < count - 1 && result == 0; i++) {
+                // > the helper pipe is empty and as large as in_fd, so the whole block fits in
+                if (tee(in_fd, helpers[i][1], block, 0) != block) result = -1;
+            }
+            if (result == 0 && splice_all(in_fd, out_fds[count - 1], block) != 0) result = -1;
+            for (int i = 0; i < count - 1 && result == 0; i++) {
+                if (splice_all(helpers[i][0], out_fds[i], block) != 0) result = -1;
+            }
+            if (result != 0) break;
+        }
+#endif
+    } else {
+        char buffer[SPLICE_BLOCK];
+        ssize_t n;
+        while ((n = read(in_fd, buffer, sizeof(buffer))) != 0) {
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) {
+                result = -1;
+                break;
+            }
+            for (int i = 0; i < count; i++) {
+                if (write_all(out_fds[i], buffer, n) != 0) result = -1;
+            }
+        }
+    }
+
+    for (int i = 0; i < helper_count; i++) {
+        close(helpers[i][0]);
+        close(helpers[i][1]);
+    }
+    free(helpers);
+    return result;
+}
+
+/*
+ * Built-in: cat [FILE...], copies the files (or stdin for none and "-") to stdout with copy_fd().
+ * Like tee it is marked as forked in builtins[]: it runs in a child without exec, so Ctrl+C ends it.
+ * With options (e.g. cat -n) the external cat is executed instead.
+ */
+int builtin_cat(int argc, char **argv, int fds[3]) {
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == '-' && argv[i][1] != '\0') exec_command(argv);
+    }
+
+    int status = 0;
+    for (int i = 1; i < argc || i == 1; i++) {
+        int from_stdin = argc == 1 || strcmp(argv[i], "-") == 0;
+        int fd = from_stdin ? fds[0] : open(argv[i], O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            fprintf(stderr, "cat: %s: %s\n", argv[i], strerror(errno));
+            status = 1;
+            continue;
+        }
+        if (copy_fd(fd, fds[1]) != 0) {
+            fprintf(stderr, "cat: %s: %s\n", from_stdin ? "-" : argv[i], strerror(errno));
+            status = 1;
+        }
+        if (!from_stdin) close(fd);
+    }
+    return status;
+}
+
+/*
+ * Built-in: tee [-a] [FILE...], copies stdin to stdout and to every file with tee_fds().
+ * With other options the external tee is executed instead.
+ */
+int builtin_tee(int argc, char **argv, int fds[3]) {
+    int append = 0;
+    int first_file = 1;
+    for (; first_file < argc && argv[first_file][0] == '-' && argv[first_file][1] != '\0'; first_file++) {
+        if (strcmp(argv[first_file], "-a") == 0) append = 1;
+        else exec_command(argv);
+    }
+
+    int out_fds[MAX_ARGS];
+    int count = 0;
+    int status = 0;
+    for (int i = first_file; i < argc; i++) {
+        int fd = open(argv[i], O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC), 0666);
+        if (fd < 0) {
+            fprintf(stderr, "tee: %s: %s\n", argv[i], strerror(errno));
+            status = 1;
+            continue;
+        }
+        out_fds[count++] = fd;
+    }
+    out_fds[count++] = fds[1]; // > stdout is the last output, it gets the block with splice() directly from stdin
+
+    if (tee_fds(fds[0], out_fds, count) != 0) {
+        fprintf(stderr, "tee: %s\n", strerror(errno));
+        status = 1;
+    }
+    for (int i = 0; i < count - 1; i++) close(out_fds[i]);
+    return status;
+}
+
+// Appends an input line to the history, empty lines are not stored
+void add_history(const char *line) {
+    while (*line == ' ') line++;
+    if (*line == '\0') return;
+    char *copy = strdup(line);
+    if (!copy) return;
+    if (history_count == MAX_HISTORY) {
+        free(history[0]);
+        memmove(history, history + 1, (MAX_HISTORY - 1) * sizeof(history[0]));
+        history_count--;
+    }
+    history[history_count++] = copy;
+}
+
+// Sets the variable NAME=VALUE (or only marks an existing NAME) as exported, so that it is saved in the session
+int export_variable(const char *assignment) {
+    char name[PATH_MAX];
+    const char *equals = strchr(assignment, '=');
+    size_t len = equals ? (size_t)(equals - assignment) : strlen(assignment);
+    if (len == 0 || len >= sizeof(name)) return -1;
+    memcpy(name, assignment, len);
+    name[len] = '\0';
+
+    if (equals && setenv(name, equals + 1, 1) != 0) return -1;
+    if (strcmp(name, "PATH") == 0) command_cache_count = 0; // > the resolved paths may be wrong now
+
+    for (int i = 0; i < exported_count; i++) {
+        if (strcmp(exported[i], name) == 0) return 0;
+    }
+    if (exported_count == MAX_EXPORTS) return -1;
+    exported[exported_count] = strdup(name);
+    return exported[exported_count] ? (exported_count++, 0) : -1;
+}
+
+/*
+ * Session snapshot (opt-in with MINISHELL_SESSION=FILE): the state of the shell is written on exit and loaded
+ * at the next start, so a new shell is warm from the first command.
+ * The file starts with SESSION_MAGIC, then follow records: a header (type and length of the data) and the data.
+ * Strings are stored without '\0'. The records are in this order:
+ *   SESSION_CWD        working directory
+ *   SESSION_EXPORT     NAME=VALUE of an exported variable
+ *   SESSION_PATH       value of PATH when the command paths were resolved
+ *   SESSION_PATH_DIR   mtime (two int64: seconds, nanoseconds, -1 if missing) and path of one PATH directory
+ *   SESSION_COMMAND    NAME '\0' PATH of a resolved command
+ *   SESSION_HISTORY    one history line
+ * A program added to or removed from a PATH directory changes the mtime of the directory. If PATH or one of the
+ * mtimes differs at the start, the command paths are not loaded.
+ */
+#define SESSION_MAGIC "MSHSESS1" // > the last character is the version of the format
+#define SESSION_MAGIC_LEN 8
+
+enum session_type { SESSION_CWD = 1, SESSION_EXPORT, SESSION_PATH, SESSION_PATH_DIR, SESSION_COMMAND, SESSION_HISTORY };
+
+struct session_record {
+    uint32_t type;
+    uint32_t length; // > bytes of data after this header
+};
+
+struct session_buffer {
+    char *data;
+    size_t len, cap;
+    int failed; // > realloc() failed, the snapshot is not written
+};
+
+// Appends len bytes to the buffer, it grows by doubling
+void session_write(struct session_buffer *buffer, const void *data, size_t len) {
+    if (buffer->failed) return;
+    if (buffer->len + len > buffer->cap) {
+        size_t cap = buffer->cap ? buffer->cap : 4096;
+        while (cap < buffer->len + len) cap *= 2;
+        char *grown = realloc(buffer->data, cap);
+        if (!grown) {
+            buffer->failed = 1;
+            return;
+        }
+        buffer->data = grown;
+        buffer->cap = cap;
+    }
+    memcpy(buffer->data + buffer->len, data, len);
+    buffer->len += len;
+}
+
+// Appends a record: header and data
+void session_append(struct session_buffer *buffer, uint32_t type, const void *data, size_t len) {
+    struct session_record record = { .type = type, .length = (uint32_t)len };
+    session_write(buffer, &record, sizeof(record));
+    session_write(buffer, data, len);
+}
+
+/*
+ * Writes the session snapshot to path. The data is written to path.tmp.<pid> first, which is then renamed
+ * to path. rename() is atomic, a shell that starts at the same time reads either the old or the new snapshot.
+ * Returns 0 on success, -1 on error.
+ */
+int save_session(const char *path) {
+    struct session_buffer buffer = { 0 };
+    char data[PATH_MAX * 4 + 16];
+    session_write(&buffer, SESSION_MAGIC, SESSION_MAGIC_LEN);
+
+    if (getcwd(data, sizeof(data))) session_append(&buffer, SESSION_CWD, data, strlen(data));
+
+    for (int i = 0; i < exported_count; i++) {
+        const char *value = getenv(exported[i]);
+        if (!value) continue; // > removed from the environment in the meantime
+        char *assignment;
+        if (asprintf(&assignment, "%s=%s", exported[i], value) < 0) continue;
+        session_append(&buffer, SESSION_EXPORT, assignment, strlen(assignment));
+        free(assignment);
+    }
+
+    const char *path_env = getenv("PATH");
+    if (path_env && command_cache_count > 0) {
+        session_append(&buffer, SESSION_PATH, path_env, strlen(path_env));
+        char dirs[PATH_MAX * 4];
+        snprintf(dirs, sizeof(dirs), "%s", path_env);
+        char *saveptr;
+        for (char *dir = strtok_r(dirs, ":", &saveptr); dir; dir = strtok_r(NULL, ":", &saveptr)) {
+            struct stat st;
+            int64_t mtime[2] = { -1, -1 };
+            if (stat(dir, &st) == 0) {
+                mtime[0] = st.st_mtim.tv_sec;
+                mtime[1] = st.st_mtim.tv_nsec;
+            }
+            memcpy(data, mtime, sizeof(mtime));
+            size_t len = strlen(dir);
+            memcpy(data + sizeof(mtime), dir, len);
+            session_append(&buffer, SESSION_PATH_DIR, data, sizeof(mtime) + len);
+        }
+        for (int i = 0; i < command_cache_count; i++) {
+            int len = snprintf(data, sizeof(data), "%s%c%s", command_cache[i].name, '\0', command_cache[i].path);
+            session_append(&buffer, SESSION_COMMAND, data, len);
+        }
+    }
+
+    for (int i = 0; i < history_count; i++) {
+        session_append(&buffer, SESSION_HISTORY, history[i], strlen(history[i]));
+    }
+
+    char temp[PATH_MAX + 32];
+    snprintf(temp, sizeof(temp), "%s.tmp.%d", path, (int)getpid());
+    int fd = buffer.failed ? -1 : open(temp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    int result = -1;
+    if (fd >= 0) {
+        int written = write_all(fd, buffer.data, buffer.len);
+        if (close(fd) == 0 && written == 0 && rename(temp, path) == 0) result = 0;
+        else unlink(temp);
+    }
+    free(buffer.data);
+    return result;
+}
+
+// Returns 1 if PATH and the mtimes of its directories are still the same as in the snapshot
+int session_path_valid(const char *saved_path, size_t saved_len, const char *records, const char *end) {
+    const char *path_env = getenv("PATH");
+    if (!path_env || strlen(path_env) != saved_len || memcmp(path_env, saved_path, saved_len) != 0) return 0;
+
+    while (records + sizeof(struct session_record) <= end) {
+        struct session_record record;
+        memcpy(&record, records, sizeof(record)); // > the data in the file is not aligned
+        const char *data = records + sizeof(record);
+        if (record.length > (size_t)(end - data)) return 0;
+        records = data + record.length;
+        if (record.type != SESSION_PATH_DIR) continue;
+
+        int64_t mtime[2];
+        char dir[PATH_MAX];
+        size_t len = record.length - sizeof(mtime);
+        if (record.length < sizeof(mtime) || len >= sizeof(dir)) return 0;
+        memcpy(mtime, data, sizeof(mtime));
+        memcpy(dir, data + sizeof(mtime), len);
+        dir[len] = '\0';
+
+        struct stat st;
+        int64_t now[2] = { -1, -1 };
+        if (stat(dir, &st) == 0) {
+            now[0] = st.st_mtim.tv_sec;
+            now[1] = st.st_mtim.tv_nsec;
+        }
+        if (now[0] != mtime[0] || now[1] != mtime[1]) return 0;
+    }
+    return 1;
+}
+
+/*
+ * Loads the session snapshot from path with mmap(), see save_session() for the format.
+ * A missing file is a new session. A damaged one is ignored with a warning, so the shell still starts.
+ */
+void load_session(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < SESSION_MAGIC_LEN) {
+        close(fd);
+        return;
+    }
+    char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // > the mapping stays valid without the fd
+    if (map == MAP_FAILED) {
+        perror("session: mmap failed");
+        return;
+    }
+
+    const char *end = map + st.st_size;
+    const char *p = map + SESSION_MAGIC_LEN;
+    int commands_valid = 0;
+    if (memcmp(map, SESSION_MAGIC, SESSION_MAGIC_LEN) != 0) {
+        fprintf(stderr, "session: %s is not a session snapshot of this version, ignored\n", path);
+        p = end;
+    }
+
+    while (p < end) {
+        struct session_record record;
+        if ((size_t)(end - p) < sizeof(record)) break;
+        memcpy(&record, p, sizeof(record));
+        const char *data = p + sizeof(record);
+        if (record.length > (size_t)(end - data)) {
+            fprintf(stderr, "session: %s is damaged, the rest is ignored\n", path);
+            break;
+        }
+        p = data + record.length;
+
+        char *text = malloc(record.length + 1); // > the strings in the file are not terminated
+        if (!text) break;
+        memcpy(text, data, record.length);
+        text[record.length] = '\0';
+        switch (record.type) {
+            case SESSION_CWD:
+                if (chdir(text) != 0) fprintf(stderr, "session: cd %s: %s\n", text, strerror(errno));
+                break;
+            case SESSION_EXPORT:
+                export_variable(text);
+                break;
+            case SESSION_PATH:
+                commands_valid = session_path_valid(data, record.length, p, end);
+                if(DEBUG) printf("[DEBUG] session: command paths %s\n", commands_valid ? "valid" : "outdated");
+                break;
+            case SESSION_COMMAND: {
+                size_t name_len = strlen(text); // > NAME '\0' PATH
+                if (commands_valid && name_len < record.length) remember_command(text, text + name_len + 1);
+                break;
+            }
+            case SESSION_HISTORY:
+                add_history(text);
+                break;
+        }
+        free(text);
+    }
+    munmap(map, st.st_size);
+}
+
+/*
+ * Built-in: export [NAME[=VALUE]...]
+ * Sets the variables for the shell and all commands started later. Without arguments it lists the exported ones.
+ */
+int builtin_export(int argc, char **argv, int fds[3]) {
+    (void)fds;
+    if (argc == 1) {
+        for (int i = 0; i < exported_count; i++) {
+            const char *value = getenv(exported[i]);
+            if (value) printf("%s=%s\n", exported[i], value);
+        }
+        return 0;
+    }
+    int status = 0;
+    for (int i = 1; i < argc; i++) {
+        if (export_variable(argv[i]) != 0) {
+            fprintf(stderr, "export: cannot export '%s'\n", argv[i]);
+            status = 1;
+        }
+    }
+    return status;
+}
+
+// Built-in: history, lists the input lines (also the ones of a loaded session)
+int builtin_history(int argc, char **argv, int fds[3]) {
+    (void)argc; (void)argv; (void)fds;
+    for (int i = 0; i < history_count; i++) {
+        printf("%5d  %s\n", i + 1, history[i]);
+    }
+    return 0;
+}
+
+// Built-in: hash lists the resolved command paths, hash -r forgets them
+int builtin_hash(int argc, char **argv, int fds[3]) {
+    (void)fds;
+    if (argc == 2 && strcmp(argv[1], "-r") == 0) {
+        command_cache_count = 0;
+        return 0;
+    }
+    if (argc != 1) {
+        fprintf(stderr, "Usage: hash [-r]\n");
+        return 2;
+    }
+    for (int i = 0; i < command_cache_count; i++) {
+        printf("%s\t%s\n", command_cache[i].name, command_cache[i].path);
+    }
+    return 0;
+}
+
+/*
+ * Built-in: capture [on|off]
+ * With `capture on` the output of every foreground command is also kept for `last`. The commands then write
+ * into a pipe instead of the terminal (e.g. ls prints one name per line). `capture off` frees the buffers.
+ */
+int builtin_capture(int argc, char **argv, int fds[3]) {
+    (void)fds;
+    if (argc == 1) {
+        printf("capture %s\n", capture_enabled ? "on" : "off");
+        return 0;
+    }
+    if (argc == 2 && strcmp(argv[1], "on") == 0) {
+        if (!capture_enabled) {
+            for (int i = 0; i < MAX_CAPTURES + 1; i++) captures[i].fd = -1; // > the memfds are created when a slot is used
+            capture_count = 0;
+        }
+        capture_enabled = 1;
+        return 0;
+    }
+    if (argc == 2 && strcmp(argv[1], "off") == 0) {
+        for (int i = 0; capture_enabled && i < MAX_CAPTURES + 1; i++) {
+            if (captures[i].fd >= 0) close(captures[i].fd);
+            free(captures[i].command);
+            captures[i].command = NULL;
+        }
+        capture_enabled = 0;
+        capture_count = 0;
+        return 0;
+    }
+    fprintf(stderr, "Usage: capture [on|off]\n");
+    return 2;
+}
+
+/*
+ * Built-in: last [N]
+ * Prints the captured output of the N-th last command (default 1) to stdout, so it can also be piped (`last | grep x`).
+ * The command, its exit status and its time are printed to stderr.
+ */
+int builtin_last(int argc, char **argv, int fds[3]) {
+    char *end = NULL;
+    long n = argc > 1 ? strtol(argv[1], &end, 10) : 1;
+    if (argc > 2 || (end && *end != '\0') || n < 1) {
+        fprintf(stderr, "Usage: last [N]\n");
+        return 2;
+    }
+    if (!capture_enabled) {
+        fprintf(stderr, "last: capture is off, turn it on with `capture on`\n");
+        return 1;
+    }
+    if (n > capture_count) {
+        fprintf(stderr, "last: only %d command(s) captured\n", capture_count);
+        return 1;
+    }
+
+    struct captured_command *slot = &captures[(capture_newest - (n - 1) + (MAX_CAPTURES + 1)) % (MAX_CAPTURES + 1)];
+    size_t kept = slot->total < CAPTURE_MAX_BYTES ? slot->total : CAPTURE_MAX_BYTES;
+    size_t offset = slot->total <= CAPTURE_MAX_BYTES ? 0 : slot->total % CAPTURE_MAX_BYTES; // > oldest byte in the ring
+    char buffer[SPLICE_BLOCK];
+    fflush(stdout);
+    while (kept > 0) {
+        size_t part = kept < sizeof(buffer) ? kept : sizeof(buffer);
+        if (part > CAPTURE_MAX_BYTES - offset) part = CAPTURE_MAX_BYTES - offset;
+        ssize_t got = pread(slot->fd, buffer, part, offset);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0 || write_all(fds[1], buffer, got) != 0) break; // > e.g. `last | head`, the reader is gone
+        kept -= got;
+        offset = (offset + got) % CAPTURE_MAX_BYTES;
+    }
+
+    char note[96] = "";
+    if (slot->total > CAPTURE_MAX_BYTES) snprintf(note, sizeof(note), ", only the last %d KiB of %zu bytes kept", CAPTURE_MAX_BYTES / 1024, slot->total);
+    // > one line in one call, so that it is not mixed with the output of a command that `last` is piped into
+    fprintf(stderr, "[last %ld] %s: exit %d, %.3f s%s\n", n, slot->command ? slot->command : "", slot->status, slot->seconds, note);
+    return 0;
+}
+
+int builtin_enable(int argc, char **argv, int fds[3]);
+
+struct builtin builtins[MAX_BUILTINS] = {
+    { "exit",    builtin_exit,    NULL, 0 },
+    { "cd",      builtin_cd,      NULL, 0 },
+    { "ret",     builtin_ret,     NULL, 0 },
+    { "jobs",    builtin_jobs,    NULL, 0 },
+    { "ulimit",  builtin_ulimit,  NULL, 0 },
+    { "enable",  builtin_enable,  NULL, 0 },
+    { "cat",     builtin_cat,     NULL, 1 },
+    { "tee",     builtin_tee,     NULL, 1 },
+    { "export",  builtin_export,  NULL, 0 },
+    { "history", builtin_history, NULL, 0 },
+    { "hash",    builtin_hash,    NULL, 0 },
+    { "capture", builtin_capture, NULL, 0 },
+    { "last",    builtin_last,    NULL, 0 },
+};
+int builtin_count = 13;
+
+// Returns the built-in with this name, or NULL if it is an external command
+struct builtin *find_builtin(const char *name) {
+    for (int i = 0; i < builtin_count; i++) {
+        if (strcmp(builtins[i].name, name) == 0) return &builtins[i];
+    }
+    return NULL;
+}
+
+/*
+ * Runs a built-in inside the shell process.
+ * Redirections (<<EOF, <<<, <&X, >&X) are put onto stdin/stdout with dup2() for the time of the call
+ * and restored afterwards. Returns the exit status of the built-in.
+ */
+int run_builtin(struct builtin *builtin, char **args) {
+    int in_fd = extract_heredoc(args);
+    int out_fd = -1;
+    if (in_fd == -2 || extract_fd_redirections(args, &in_fd, &out_fd) != 0) {
+        if (in_fd >= 0) close(in_fd);
+        return 1;
+    }
+
+    sync_input(); // > a loaded built-in may read stdin of the shell
+    fflush(stdout);
+    int saved_in = -1, saved_out = -1;
+    if (in_fd >= 0) {
+        saved_in = dup(STDIN_FILENO);
+        dup2(in_fd, STDIN_FILENO);
+        close(in_fd);
+    }
+    if (out_fd >= 0) {
+        saved_out = dup(STDOUT_FILENO);
+        dup2(out_fd, STDOUT_FILENO);
+        close(out_fd);
+    }
+
+    int argc = 0;
+    while (args[argc]) argc++;
+    int fds[3] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+    int status = builtin->handler(argc, args, fds);
+    fflush(stdout);
+
+    if (saved_in >= 0) {
+        dup2(saved_in, STDIN_FILENO);
+        close(saved_in);
+    }
+    if (saved_out >= 0) {
+        dup2(saved_out, STDOUT_FILENO);
+        close(saved_out);
+    }
+    return status;
+}
+
+/*
+ * Loads the built-in NAME from a shared library: dlopen() the library and look up the symbol NAME_builtin.
+ * Every built-in keeps its own reference of dlopen(), so it can be removed alone with `enable -d NAME`.
+ * Returns 0 on success, -1 on error.
+ */
+int load_builtin(const char *path, const char *name) {
+    struct builtin *builtin = find_builtin(name);
+    if (builtin && !builtin->library) {
+        fprintf(stderr, "enable: '%s' is a native built-in and cannot be replaced\n", name);
+        return -1;
+    }
+    if (strlen(name) >= JOB_NAME_MAX) {
+        fprintf(stderr, "enable: name '%s' is too long\n", name);
+        return -1;
+    }
+    if (!builtin && builtin_count == MAX_BUILTINS) {
+        fprintf(stderr, "enable: too many built-ins (max %d)\n", MAX_BUILTINS);
+        return -1;
+    }
+
+    void *library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!library) {
+        fprintf(stderr, "enable: %s\n", dlerror());
+        return -1;
+    }
+    char symbol[JOB_NAME_MAX + sizeof(MINISHELL_BUILTIN_SUFFIX)];
+    snprintf(symbol, sizeof(symbol), "%s%s", name, MINISHELL_BUILTIN_SUFFIX);
+    minishell_builtin_fn *handler = (minishell_builtin_fn *)dlsym(library, symbol);
+    if (!handler) {
+        fprintf(stderr, "enable: '%s' not found in %s\n", symbol, path);
+        dlclose(library);
+        return -1;
+    }
+
+    if (builtin) {
+        dlclose(builtin->library); // > loaded again, e.g. after the library was rebuilt
+    } else {
+        builtin = &builtins[builtin_count++];
+        snprintf(builtin->name, sizeof(builtin->name), "%s", name);
+    }
+    builtin->handler = handler;
+    builtin->library = library;
+    builtin->forked = 0;
+    return 0;
+}
+
+// Removes a loaded built-in from the table and closes its library
+int unload_builtin(const char *name) {
+    struct builtin *builtin = find_builtin(name);
+    if (!builtin || !builtin->library) {
+        fprintf(stderr, "enable: '%s' is not a loaded built-in\n", name);
+        return -1;
+    }
+    dlclose(builtin->library);
+    *builtin = builtins[--builtin_count]; // > the order of the table does not matter
+    return 0;
+}
+
+/*
+ * Handles the built-in `enable`:
+ *   enable                    lists all built-ins
+ *   enable -f lib.so NAME...  loads built-ins from a shared library
+ *   enable -d NAME...         removes loaded built-ins
+ */
+int builtin_enable(int argc, char **argv, int fds[3]) {
+    (void)fds;
+    if (argc == 1) {
+        for (int i = 0; i < builtin_count; i++) {
+            printf("%s%s\n", builtins[i].name, builtins[i].library ? " (loaded)" : "");
+        }
+        return 0;
+    }
+
+    int status = 0;
+    if (strcmp(argv[1], "-f") == 0 && argc >= 4) {
+        for (int i = 3; i < argc; i++) {
+            if (load_builtin(argv[2], argv[i]) != 0) status = 1;
+        }
+    } else if (strcmp(argv[1], "-d") == 0 && argc >= 3) {
+        for (int i = 2; i < argc; i++) {
+            if (unload_builtin(argv[i]) != 0) status = 1;
+        }
+    } else {
+        fprintf(stderr, "Usage: enable [-f lib.so NAME... | -d NAME...]\n");
+        status = 2;
+    }
+    return status;
+}
+
+int shell_functionality(int *retFlag) {
+    *retFlag = 1;
+    update_jobs(); // > report coprocesses that have ended since the last prompt
+    print_prompt();
+    static char *input_line = NULL; // > grows in read_input_line() and is used again for the next input
+    static size_t input_cap = 0;
+
+    if (read_input_line(&input_line, &input_cap) == -1)
+    {
+        printf("\n");
+        return 0; // EOF
+    }
+
+    input_line[strcspn(input_line, "\n")] = '\0'; // > change at the end of the line of the code
+    add_history(input_line);
+    if(DEBUG) printf("[DEBUG] shell_functionality, Input line: '%s'\n", input_line); // > for debugging purpose, so that I can see what is being given as input
+    char *saveptr;
+    char *command = split_top_level(input_line, ';', &saveptr); // > collect the collection of Strings of command, especially if there is ";"
+
+    // > The `;` is being used as the iterator through the commands that might be within the command#s array
+    // execute each command in the input line e.g. `ls; pwd; echo "Hello World"; cd /tmp`
+    // it executes ls first, then pwd, then echo "Hello World", and finally cd /tmp
+    while (command)
+    {
+        while (*command == ' ')
+            command++; // > if within the char array there are blank space, then skip it and go to the next character!
+
+        char *command_copy = strdup(command); // > copy the command into command_copy in the heap_memorry, so that it does not affect the pointer variable command when we are passing other value to other function.
+        if (!command_copy)
+        {
+            fprintf(stderr, "Error: Could not allocate memory for command.\n");
+            break;
+        }
+
+        char **args = parse_input(command_copy); // > take the command and convert them into string array, so that it could be executed with the given parameter through execv().
+        if (!args || !args[0])
         { // > if there is no command or pointers being return from parse_input, then go to the next iteration and see if there is
           // > another command that can be executed. If not then the `while(command)` ended and wait for the next input.
             free(command_copy);
             free(args);
-            command = strtok_r(NULL, ";", &saveptr);
+            command = split_top_level(NULL, ';', &saveptr);
             continue;
         }
 
-        // Built-in: exit
-        if (strcmp(args[0], "exit") == 0)
+        // Built-ins: timeout and limit, prefixes for the whole rest of the command (also a pipeline)
+        struct exec_options opts = { 0 };
+        int cmd_index = parse_exec_prefixes(args, &opts);
+
+        // Built-in: cache [--inputs FILE...] -- cmd..., also after timeout / limit, which then apply on a miss
+        if (cmd_index >= 0 && args[cmd_index] && strcmp(args[cmd_index], "cache") == 0)
         {
+            handle_cache(args + cmd_index, command, command_copy, &opts);
             free(args);
             free(command_copy);
-            printf("Shell terminated.\n");
-            return EXIT_SUCCESS;
+            command = split_top_level(NULL, ';', &saveptr);
+            continue;
         }
 
-        // Built-in: cd
-        if (strcmp(args[0], "cd") == 0)
+        if (cmd_index != 0)
         {
-            handle_cd(args);
+            if (cmd_index > 0)
+            {
+                // > args point into command_copy, at the same offset the rest of the command starts in command
+                run_foreground(command + (args[cmd_index] - command_copy), &opts);
+            }
+            free(args);
             free(command_copy);
-            free(args);                              // > This is important only if the args is being allocated in the heap memory, otherwise it will cause a memory leak!
-                                                     // > There was problem in the test case, where the args was not being freed and crahsed, therefore it caused a memory leak.
-            command = strtok_r(NULL, ";", &saveptr); // > if there is no command or pointers being return from parse_input, then go to the next iteration and see if there is
-                                                     // > another command that can be executed. If not then the `while(command)` ended and wait for the next input.
+            command = split_top_level(NULL, ';', &saveptr);
             continue;
         }
 
-        // Built-in: ret
-        if (strcmp(args[0], "ret") == 0)
+        // Built-in: coproc NAME cmd..., the rest of the command (also a pipeline) runs in the background
+        if (strcmp(args[0], "coproc") == 0)
         {
-            handle_sighup(0);
+            if (!args[1] || !args[2])
+            {
+                fprintf(stderr, "Usage: coproc NAME cmd...\n");
+                last_status = 2;
+            }
+            else
+            {
+                last_status = start_coproc(args[1], args + 2, command + (args[2] - command_copy)) == 0 ? 0 : 1;
+            }
             free(args);
             free(command_copy);
-            command = strtok_r(NULL, ";", &saveptr);
+            command = split_top_level(NULL, ';', &saveptr);
             continue;
         }
 
-        pid_t pid = fork();
-        if (pid < 0)
+        // Detect pipe command
+        char *pipe = find_top_level(command, '|'); // > a '|' inside a process substitution <(...) is not a pipe of this command
+        if (pipe)
         {
-            perror("fork failed");
-            last_status = 1;
+            run_foreground(command, NULL);
+            free(args);
+            free(command_copy);
+            command = split_top_level(NULL, ';', &saveptr); // > go to to the next available command, take the pointer to the next command.
+            continue;                                // > For the next command, we go back and see if there is Pipe or simmilar.
         }
-        else if (pid == 0)
+
+        // Built-ins (exit, cd, ret, jobs, ulimit, enable and the loaded ones) are dispatched through the table
+        struct builtin *builtin = find_builtin(args[0]);
+        if (builtin && !builtin->forked)
         {
-            // Child Process = execute the command
-            if(DEBUG) printf("[DEBUG] Executing command: %s, with strchr: %s\n", args[0], strchr(args[0], '/'));
-            if (strchr(args[0], '/') != NULL) {
-                // If the command contains a '/', treat it as a path
-                execv(args[0], args);  // exact path
-                perror("execv failed");
-            } else {
-                execvp(args[0], args); // search PATH
-                perror("execvp failed");
+            last_status = run_builtin(builtin, args);
+            free(args);                              // > This is important only if the args is being allocated in the heap memory, otherwise it will cause a memory leak!
+            free(command_copy);
+            if (exit_requested)
+            {
+                printf("Shell terminated.\n");
+                return EXIT_SUCCESS;
             }
-            exit(1);
-        }
-        else
-        {
-            // Parent Process = wait for the command to be ended
-            child_count++; // Increment child counter
-            int status;
-            waitpid(pid, &status, 0);
-            child_count--; // Decrement child counter when child finishes
-            // > see this reference for more information about WIFEXITED https://www.ibm.com/docs/xl-fortran-aix/16.1.0?topic=procedures-wifexitedstat-val
-            // > Reason: WIFEXITED if the process is not exited, then it will return 0, otherwise it will return non zero value
-            last_status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+            command = split_top_level(NULL, ';', &saveptr); // > go to the next command, if there is none the `while(command)` ends and waits for the next input.
+            continue;
         }
 
+        // External command or forked built-in: fork, execute and wait, like a pipeline with only one command
+        run_foreground(command, NULL);
+
         free(args);
         free(command_copy);
-        command = strtok_r(NULL, ";", &saveptr);
+        command = split_top_level(NULL, ';', &saveptr);
     }
     *retFlag = 0;
     return 0; // > return 0 means that the command is being executed successfully and there is no error
@@ -384,6 +3050,24 @@ int main() {
     signal(SIGINT, handle_sigint); // Catch Ctrl+C
     signal(SIGHUP, handle_sighup); // Catch SIGHUP
 
+    open_sigchld_pipe(); // > self-pipe for SIGCHLD, used by wait_for_pipeline() to wait for a child with a timeout
+
+    // Opt-in session snapshot: cwd, exported variables, command paths and history of the last shell
+    const char *session = getenv("MINISHELL_SESSION");
+    if (session && *session) {
+        // > export may change the environment, the name must stay valid until exit. A relative name is made
+        // > absolute now, otherwise a cd during the session would write the snapshot into another directory.
+        char cwd[PATH_MAX];
+        char *absolute = NULL;
+        if (session[0] != '/' && getcwd(cwd, sizeof(cwd))) {
+            if (asprintf(&absolute, "%s/%s", cwd, session) < 0) absolute = NULL;
+        } else {
+            absolute = strdup(session);
+        }
+        session = absolute;
+        if (session) load_session(session);
+    }
+
     while (1) {
         int retFlag;
         int retVal = shell_functionality(&retFlag);
@@ -393,8 +3077,13 @@ int main() {
         if (retFlag == 1) {
             // clean up ALL children, so that the processes are not left hanging
             if (DEBUG) printf("[DEBUG] Cleaning up all children processes...\n");
-            while (has_children()) {
-                wait(NULL);
+            close_jobs();
+            while (has_children() && wait(NULL) > 0) {
+                child_count--;
+            }
+            sync_input(); // > leave the rest of stdin to whoever reads it after the shell
+            if (session && *session && save_session(session) != 0) {
+                fprintf(stderr, "session: cannot write %s: %s\n", session, strerror(errno));
             }
             return retVal;
         }
@@ -19,4 +19,4 @@ gcc helpers/timeout.c -o helpers/timeout
 chmod +x helpers/timeout
 
 # Compile your minishell and run the tests
-gcc ../testat_Agha_Aslam.c -o ../minishell && ./shtest ../minishell
+gcc ../testat_Agha_Aslam.c -o ../minishell -ldl && ./shtest ../minishell